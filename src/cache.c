@@ -1,172 +1,1098 @@
 #include "cache.h"
+#include "slab.h"
+#include "probes.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
 #include <time.h>
 
-// Limite fixo de entradas
-#define MAX_CACHE_ENTRIES 100
+// Número de buckets da hash table (potência de 2)
+#define CACHE_HASH_BUCKETS 4096
 
+// W-TinyLFU: 1% dos bytes para a janela LRU, o resto para a SLRU principal
+#define WINDOW_PERCENT 1
+// Dentro da região principal, 80% ficam para a zona "protected"
+#define PROTECTED_PERCENT 80
+
+// Count-min sketch: 4 linhas de contadores saturados a 15
+#define SKETCH_DEPTH 4
+#define SKETCH_MAX_COUNT 15
+#define SKETCH_MIN_WIDTH 1024
+#define SKETCH_MAX_WIDTH (1 << 20)
+
+// L1 por thread (mapeamento direto) à frente da cache partilhada
+#define L1_MAX_SLOTS 256
+#define L1_MAX_OBJECT (16 * 1024) // Só objetos pequenos: cada slot retém a sua entrada
+#define L1_REFRESH 16             // A cada N hits no L1, o acesso passa pela cache (LRU e sketch)
+
+// Vítimas expulsas no máximo para arranjar um bloco na arena (depois disso, o objeto é recusado)
+#define ARENA_MAX_EVICTIONS 32
+#define ARENA_MAX_SCAN (4 * ARENA_MAX_EVICTIONS) // Vítimas examinadas, contando as retidas por leitores
+
+// Motivo pelo qual uma entrada sai da cache (estatísticas)
+enum { DROP_CAPACITY, DROP_STALE, DROP_RESIZE, DROP_REJECTED, DROP_DESTROY, DROP_COUNT };
+
+// Regiões onde uma entrada pode estar
+enum { LIST_WINDOW, LIST_PROBATION, LIST_PROTECTED, LIST_COUNT, LIST_NONE = -1 };
+
+// Cada entrada é um único bloco: [cache_entry_t][chave][dados]
 typedef struct cache_entry {
     char *key;
     void *data;
     size_t size;
-    time_t accessed; // Timestamp para gerir o LRU
+    size_t charge;                     // Bytes realmente ocupados pelo bloco (conta para o orçamento)
+    long segment;                      // Índice do segmento, ou CACHE_WHOLE_FILE
+    uint64_t tag;                      // Versão do ficheiro a que o segmento pertence
+    struct cache *owner;
+    uint64_t hash;
+    int refs;                          // 1 da cache + 1 por cada leitor ativo (+1 por cada L1)
+    uint64_t gen;                      // Geração atribuída na inserção; 0 depois de sair da cache
+    int list;                          // Região atual (LIST_NONE se já saiu da cache)
+    int heap_idx;                      // Posição no heap GDSF (-1 se não estiver)
+    uint32_t hits;                     // Acessos (prioridade GDSF e snapshot do hot set)
+    double priority;                   // GDSF: H = L + hits / tamanho
+    struct cache_entry *prev, *next;   // Lista LRU da região
+    struct cache_entry *hnext;         // Cadeia do bucket
 } cache_entry_t;
 
+typedef struct {
+    cache_entry_t *head; // Mais recente
+    cache_entry_t *tail; // Menos recente (candidato a sair)
+    size_t bytes;
+    int count;
+} lru_list_t;
+
+// Estimativa de frequência (TinyLFU) com envelhecimento periódico
+typedef struct {
+    uint8_t *table;        // SKETCH_DEPTH linhas de "width" contadores
+    uint32_t width_mask;
+    uint32_t additions;
+    uint32_t sample_size;  // Ao atingir este número de acessos, todos os contadores são divididos por 2
+} freq_sketch_t;
+
+// Carregamento em curso de uma chave (single-flight): quem falha a seguir espera por ele
+typedef struct cache_fill {
+    char *key;
+    long segment;
+    uint64_t tag;
+    int done;
+    int users;                 // Líder + threads à espera
+    struct timespec start;     // Início do carregamento (tempo médio de fill)
+    cache_entry_t *entry;      // Resultado (o fill guarda uma referência própria)
+    pthread_cond_t cond;
+    struct cache_fill *next;
+} cache_fill_t;
+
 struct cache {
-    cache_entry_t *entries;
+    cache_entry_t *buckets[CACHE_HASH_BUCKETS];
+    lru_list_t lists[LIST_COUNT];
     int num_entries;
-    int max_entries;
     size_t max_size;
+    size_t max_limit;      // Teto de max_size (CACHE_MAX_SIZE_MB com CACHE_ADAPTIVE): tamanho da arena
     size_t current_size;
+    size_t data_size;      // Só os corpos (current_size - data_size = metadados e arredondamento)
+    size_t window_max;     // Orçamento da janela
+    size_t protected_max;  // Orçamento da zona protected
+    size_t max_object;     // Maior objeto admitido
+    size_t segment_size;   // Tamanho dos segmentos de ficheiros grandes (0 = desligado)
+    int admission;         // CACHE_ADMISSION_*
+    int policy;            // CACHE_POLICY_*
+    slab_arena_t *arena;   // Arena de slabs (NULL = malloc)
+    pthread_mutex_t arena_lock; // A arena não é thread-safe; este lock é sempre o último a ser adquirido
+    pthread_mutex_t fill_lock;  // Protege "fills"; adquirido antes do rwlock, nunca depois
+    cache_fill_t *fills;        // Carregamentos em curso
+    cache_entry_t **heap;  // GDSF: min-heap por prioridade (vítima no topo)
+    int heap_len;
+    int heap_cap;
+    double inflation;      // GDSF: "L", prioridade da última vítima
+    freq_sketch_t sketch;
+    int l1_mask;           // Slots do L1 - 1 (-1 = desligado)
+    // Estatísticas: as primeiras alteradas com o lock de escrita, as restantes com atomics
+    uint64_t hits, l1_hits, misses, drops[DROP_COUNT], admission_rejects;
+    uint64_t size_rejects, fill_count, fill_time_us;
+    uint64_t next_gen;
     pthread_rwlock_t rwlock; // Lock de leitura/escrita para garantir thread-safety
 };
 
-// Inicializa a cache e define o tamanho máximo em MB
-cache_t* cache_init(size_t max_size_mb) {
-    cache_t *cache = malloc(sizeof(cache_t));
+// Slot do L1: a entrada fica reservada pelo L1 e é "emprestada" aos pedidos desta thread
+// sem lock nem escrita partilhada. A geração diz se ainda está na cache.
+typedef struct {
+    cache_t *owner;
+    cache_entry_t *entry;
+    uint64_t gen;
+    uint32_t uses;
+    uint32_t borrowed; // Empréstimos ainda por devolver com cache_release
+} l1_slot_t;
+
+static __thread l1_slot_t l1[L1_MAX_SLOTS];
+static __thread uint64_t l1_hits_pending; // Hits no L1 ainda não somados à cache (evita escrita partilhada)
+
+// FNV-1a de 64 bits
+static uint64_t hash_key(const char *key) {
+    uint64_t h = 1469598103934665603ULL;
+    while (*key) {
+        h ^= (unsigned char)*key++;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static int sketch_init(freq_sketch_t *sk, size_t max_size) {
+    // Estima o número de entradas assumindo ficheiros de ~4KB
+    size_t expected = max_size / 4096;
+    uint32_t width = SKETCH_MIN_WIDTH;
+    while (width < expected && width < SKETCH_MAX_WIDTH) width <<= 1;
+
+    sk->table = calloc((size_t)SKETCH_DEPTH * width, sizeof(uint8_t));
+    if (!sk->table) return -1;
+    sk->width_mask = width - 1;
+    sk->additions = 0;
+    sk->sample_size = 10 * width;
+    return 0;
+}
+
+// Índice do contador na linha "row" (double hashing a partir do hash de 64 bits)
+static inline uint32_t sketch_index(const freq_sketch_t *sk, uint64_t hash, int row) {
+    uint32_t h1 = (uint32_t)hash;
+    uint32_t h2 = (uint32_t)(hash >> 32) | 1;
+    return row * (sk->width_mask + 1) + ((h1 + row * h2) & sk->width_mask);
+}
+
+static int sketch_frequency(const freq_sketch_t *sk, uint64_t hash) {
+    int freq = SKETCH_MAX_COUNT;
+    for (int r = 0; r < SKETCH_DEPTH; r++) {
+        int c = sk->table[sketch_index(sk, hash, r)];
+        if (c < freq) freq = c;
+    }
+    return freq;
+}
+
+// Envelhecimento: divide todos os contadores por 2 para esquecer o histórico antigo
+static void sketch_age(freq_sketch_t *sk) {
+    size_t total = (size_t)SKETCH_DEPTH * (sk->width_mask + 1);
+    for (size_t i = 0; i < total; i++) sk->table[i] >>= 1;
+    sk->additions /= 2;
+}
+
+static void sketch_increment(freq_sketch_t *sk, uint64_t hash) {
+    int added = 0;
+    for (int r = 0; r < SKETCH_DEPTH; r++) {
+        uint8_t *c = &sk->table[sketch_index(sk, hash, r)];
+        if (*c < SKETCH_MAX_COUNT) { (*c)++; added = 1; }
+    }
+    if (added && ++sk->additions >= sk->sample_size) sketch_age(sk);
+}
+
+static void list_remove(lru_list_t *l, cache_entry_t *e) {
+    if (e->prev) e->prev->next = e->next; else l->head = e->next;
+    if (e->next) e->next->prev = e->prev; else l->tail = e->prev;
+    e->prev = e->next = NULL;
+    l->bytes -= e->charge;
+    l->count--;
+}
+
+static void list_push_head(lru_list_t *l, cache_entry_t *e) {
+    e->prev = NULL;
+    e->next = l->head;
+    if (l->head) l->head->prev = e; else l->tail = e;
+    l->head = e;
+    l->bytes += e->charge;
+    l->count++;
+}
+
+static void entry_move(cache_t *cache, cache_entry_t *e, int to) {
+    list_remove(&cache->lists[e->list], e);
+    e->list = to;
+    list_push_head(&cache->lists[to], e);
+}
+
+// Hash de (caminho, segmento). Para o ficheiro inteiro é apenas o hash do caminho.
+static inline uint64_t hash_segment(const char *key, long segment) {
+    return hash_key(key) ^ ((uint64_t)(segment + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+static cache_entry_t* hash_lookup(cache_t *cache, const char *key, long segment, uint64_t hash) {
+    cache_entry_t *e = cache->buckets[hash & (CACHE_HASH_BUCKETS - 1)];
+    for (; e; e = e->hnext) {
+        if (e->hash == hash && e->segment == segment && strcmp(e->key, key) == 0) return e;
+    }
+    return NULL;
+}
+
+static void hash_remove(cache_t *cache, cache_entry_t *e) {
+    cache_entry_t **pp = &cache->buckets[e->hash & (CACHE_HASH_BUCKETS - 1)];
+    while (*pp && *pp != e) pp = &(*pp)->hnext;
+    if (*pp) *pp = e->hnext;
+    e->hnext = NULL;
+}
+
+static inline void heap_swap(cache_t *cache, int a, int b) {
+    cache_entry_t *t = cache->heap[a];
+    cache->heap[a] = cache->heap[b];
+    cache->heap[b] = t;
+    cache->heap[a]->heap_idx = a;
+    cache->heap[b]->heap_idx = b;
+}
+
+static void heap_sift_up(cache_t *cache, int i) {
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (cache->heap[parent]->priority <= cache->heap[i]->priority) break;
+        heap_swap(cache, i, parent);
+        i = parent;
+    }
+}
+
+static void heap_sift_down(cache_t *cache, int i) {
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, min = i;
+        if (l < cache->heap_len && cache->heap[l]->priority < cache->heap[min]->priority) min = l;
+        if (r < cache->heap_len && cache->heap[r]->priority < cache->heap[min]->priority) min = r;
+        if (min == i) break;
+        heap_swap(cache, i, min);
+        i = min;
+    }
+}
+
+static int heap_push(cache_t *cache, cache_entry_t *e) {
+    if (cache->heap_len == cache->heap_cap) {
+        int cap = cache->heap_cap ? cache->heap_cap * 2 : 256;
+        cache_entry_t **h = realloc(cache->heap, cap * sizeof(cache_entry_t*));
+        if (!h) return -1;
+        cache->heap = h;
+        cache->heap_cap = cap;
+    }
+    e->heap_idx = cache->heap_len++;
+    cache->heap[e->heap_idx] = e;
+    heap_sift_up(cache, e->heap_idx);
+    return 0;
+}
+
+static void heap_remove(cache_t *cache, cache_entry_t *e) {
+    int i = e->heap_idx;
+    int last = --cache->heap_len;
+    if (i != last) {
+        heap_swap(cache, i, last);
+        heap_sift_down(cache, i);
+        heap_sift_up(cache, i);
+    }
+    e->heap_idx = -1;
+}
+
+// Prioridade GDSF: objetos pequenos e muito pedidos ficam; a inflação envelhece os restantes
+static inline double gdsf_priority(cache_t *cache, uint32_t hits, size_t size) {
+    return cache->inflation + (double)hits / (double)(size ? size : 1);
+}
+
+static inline size_t align16(size_t n) { return (n + 15) & ~(size_t)15; }
+
+static void entry_free(cache_entry_t *e) {
+    cache_t *cache = e->owner;
+    if (cache->arena) {
+        pthread_mutex_lock(&cache->arena_lock);
+        slab_free(cache->arena, e);
+        pthread_mutex_unlock(&cache->arena_lock);
+    } else {
+        free(e);
+    }
+}
+
+// Próxima vítima da política ativa (usada quando a arena não tem bloco livre)
+static cache_entry_t* pick_victim(cache_t *cache) {
+    if (cache->heap_len > 0) return cache->heap[0];
+    if (cache->lists[LIST_PROBATION].tail) return cache->lists[LIST_PROBATION].tail;
+    if (cache->lists[LIST_PROTECTED].tail) return cache->lists[LIST_PROTECTED].tail;
+    return cache->lists[LIST_WINDOW].tail;
+}
+
+// Larga uma referência real (da cache, de um leitor ou de um L1)
+static void entry_unref(cache_entry_t *e) {
+    if (__sync_sub_and_fetch(&e->refs, 1) == 0) entry_free(e);
+}
+
+// Retira a entrada da cache. A memória só é libertada quando o último leitor a largar.
+static void entry_drop(cache_t *cache, cache_entry_t *e, int reason) {
+    cache->drops[reason]++;
+    PROBE_CACHE_EVICT(e->key, e->segment, e->size, reason);
+    hash_remove(cache, e);
+    if (e->list != LIST_NONE) list_remove(&cache->lists[e->list], e);
+    if (e->heap_idx >= 0) heap_remove(cache, e);
+    e->list = LIST_NONE;
+    cache->current_size -= e->charge;
+    cache->data_size -= e->size;
+    cache->num_entries--;
+    __atomic_store_n(&e->gen, 0, __ATOMIC_RELEASE); // Invalida as cópias nos L1
+    entry_unref(e);
+}
+
+// Próxima vítima das listas LRU depois de "e" (NULL: a primeira), pela ordem de pick_victim
+static cache_entry_t* lru_victim_after(cache_t *cache, cache_entry_t *e) {
+    static const int order[] = { LIST_PROBATION, LIST_PROTECTED, LIST_WINDOW };
+    int k = 0;
+    if (e) {
+        if (e->prev) return e->prev;
+        while (order[k] != e->list) k++;
+        k++;
+    }
+    for (; k < 3; k++) {
+        if (cache->lists[order[k]].tail) return cache->lists[order[k]].tail;
+    }
+    return NULL;
+}
+
+// Arena cheia: planeia as vítimas pela ordem da política sem mexer na cache e só as expulsa
+// se, juntas, libertarem um bloco para o pedido (e o TinyLFU admitir o objeto contra cada
+// uma). Uma recusa nunca custa entradas. Vítimas com leitores ficam de fora: sairiam da
+// cache mas o bloco continuaria ocupado. Chamado com o lock de escrita.
+static cache_entry_t* arena_make_room(cache_t *cache, uint64_t hash, size_t total) {
+    cache_entry_t *plan[ARENA_MAX_EVICTIONS];
+    void *blocks[ARENA_MAX_EVICTIONS];
+    cache_entry_t *popped[ARENA_MAX_SCAN]; // Tiradas do heap para o percorrer por ordem
+    int planned = 0, npopped = 0, fits = 0;
+    cache_entry_t *pos = NULL;             // Posição nas listas LRU
+
+    for (int scanned = 0; scanned < ARENA_MAX_SCAN && planned < ARENA_MAX_EVICTIONS && !fits; scanned++) {
+        cache_entry_t *victim;
+        if (cache->heap_len > 0) {
+            victim = cache->heap[0];
+            heap_remove(cache, victim);
+            popped[npopped++] = victim;
+        } else {
+            victim = pos = lru_victim_after(cache, pos);
+            if (!victim) break;
+        }
+        // Só a cache a referencia: ninguém a pode reservar sem o lock de escrita que temos
+        if (__atomic_load_n(&victim->refs, __ATOMIC_ACQUIRE) > 1) continue;
+        if (cache->admission == CACHE_ADMISSION_TINYLFU &&
+            sketch_frequency(&cache->sketch, hash) <= sketch_frequency(&cache->sketch, victim->hash)) break;
+
+        plan[planned] = victim;
+        blocks[planned++] = victim;
+        pthread_mutex_lock(&cache->arena_lock);
+        fits = slab_fits_after_free(cache->arena, total, blocks, planned);
+        pthread_mutex_unlock(&cache->arena_lock);
+    }
+
+    // As do heap que não vão sair voltam (cabem sempre: o heap já as tinha)
+    for (int i = 0; i < npopped; i++) {
+        int leaving = 0;
+        for (int k = 0; fits && k < planned && !leaving; k++) leaving = plan[k] == popped[i];
+        if (!leaving) heap_push(cache, popped[i]);
+    }
+    if (!fits) return NULL;
+
+    for (int i = 0; i < planned; i++) {
+        if (plan[i]->list == LIST_NONE) cache->inflation = plan[i]->priority; // Do heap, por ordem
+        entry_drop(cache, plan[i], DROP_CAPACITY);
+    }
+    // Só esta thread reserva blocos (lock de escrita); as outras só libertam
+    pthread_mutex_lock(&cache->arena_lock);
+    cache_entry_t *e = slab_alloc(cache->arena, total);
+    pthread_mutex_unlock(&cache->arena_lock);
+    return e;
+}
+
+// Reserva o bloco da entrada. Com arena, tem de ser chamado com o lock de escrita:
+// se não houver bloco livre, expulsa as vítimas que o libertam (ver arena_make_room).
+// Libertar blocos pequenos nem sempre liberta páginas inteiras, por isso desiste ao fim
+// de ARENA_MAX_EVICTIONS vítimas em vez de esvaziar a cache por um só objeto.
+static cache_entry_t* entry_alloc(cache_t *cache, const char *key, uint64_t hash, size_t size) {
+    size_t key_len = strlen(key) + 1;
+    size_t total = align16(sizeof(cache_entry_t)) + align16(key_len) + size;
+    cache_entry_t *e;
+    size_t charge;
+
+    if (cache->arena) {
+        // Nunca caberia (maior do que a arena ou do que o orçamento atual): nem tenta
+        charge = slab_chunk_size(cache->arena, total);
+        if (charge == 0 || charge > cache->max_size) {
+            __sync_fetch_and_add(&cache->size_rejects, 1);
+            return NULL;
+        }
+        pthread_mutex_lock(&cache->arena_lock);
+        e = slab_alloc(cache->arena, total);
+        pthread_mutex_unlock(&cache->arena_lock);
+        if (!e && !(e = arena_make_room(cache, hash, total))) {
+            cache->admission_rejects++;
+            return NULL;
+        }
+    } else {
+        e = malloc(total);
+        if (!e) return NULL;
+        charge = total;
+    }
+
+    memset(e, 0, sizeof(cache_entry_t));
+    e->key = (char*)e + align16(sizeof(cache_entry_t));
+    e->data = e->key + align16(key_len);
+    memcpy(e->key, key, key_len);
+    e->size = size;
+    e->charge = charge;
+    e->hash = hash;
+    e->owner = cache;
+    return e;
+}
+
+// O candidato saído da janela tenta entrar na região principal.
+// Com TinyLFU, só entra se for mais frequente do que cada vítima que teria de expulsar.
+static void admit_candidate(cache_t *cache, cache_entry_t *cand) {
+    size_t main_max = cache->max_size - cache->window_max;
+    lru_list_t *probation = &cache->lists[LIST_PROBATION];
+    lru_list_t *protected = &cache->lists[LIST_PROTECTED];
+
+    if (cand->charge > main_max) {
+        entry_drop(cache, cand, DROP_REJECTED);
+        return;
+    }
+
+    while (probation->bytes + protected->bytes + cand->charge > main_max) {
+        cache_entry_t *victim = probation->tail ? probation->tail : protected->tail;
+        if (!victim) break;
+
+        if (cache->admission == CACHE_ADMISSION_TINYLFU &&
+            sketch_frequency(&cache->sketch, cand->hash) <= sketch_frequency(&cache->sketch, victim->hash)) {
+            entry_drop(cache, cand, DROP_REJECTED);
+            return;
+        }
+        entry_drop(cache, victim, DROP_CAPACITY);
+    }
+
+    cand->list = LIST_PROBATION;
+    list_push_head(probation, cand);
+}
+
+// Esvazia a janela para a região principal enquanto exceder o seu orçamento
+static void evict_overflow(cache_t *cache) {
+    lru_list_t *window = &cache->lists[LIST_WINDOW];
+    while (window->bytes > cache->window_max && window->tail) {
+        cache_entry_t *cand = window->tail;
+        list_remove(window, cand);
+        cand->list = LIST_NONE;
+        admit_candidate(cache, cand);
+    }
+}
+
+// GDSF: expulsa as entradas de menor prioridade até o novo objeto caber.
+// Com TinyLFU, o candidato só entra se tiver mais acessos por byte do que cada vítima:
+// a decisão é tomada antes de expulsar, para uma recusa não esvaziar a cache à toa.
+static int gdsf_make_room(cache_t *cache, cache_entry_t *cand) {
+    if (cache->current_size + cand->charge <= cache->max_size) return 0;
+
+    if (cache->admission == CACHE_ADMISSION_TINYLFU) {
+        // As vítimas saem só do heap; voltam todas se o candidato perder contra alguma
+        cache_entry_t **victims = malloc((cache->heap_len + 1) * sizeof(cache_entry_t*));
+        if (!victims) return -1;
+        double cand_density = (double)sketch_frequency(&cache->sketch, cand->hash) / cand->charge;
+        size_t freed = 0;
+        int n = 0, admitted = 1;
+        while (cache->current_size - freed + cand->charge > cache->max_size && cache->heap_len > 0) {
+            cache_entry_t *victim = cache->heap[0];
+            if (cand_density <= (double)sketch_frequency(&cache->sketch, victim->hash) / victim->charge) {
+                admitted = 0;
+                break;
+            }
+            heap_remove(cache, victim);
+            victims[n++] = victim;
+            freed += victim->charge;
+        }
+        for (int i = 0; i < n; i++) {
+            if (admitted) {
+                cache->inflation = victims[i]->priority; // Saem por ordem crescente de prioridade
+                entry_drop(cache, victims[i], DROP_CAPACITY);
+            } else {
+                heap_push(cache, victims[i]); // Cabe sempre: o heap já as tinha
+            }
+        }
+        free(victims);
+        return admitted ? 0 : -1;
+    }
+
+    while (cache->current_size + cand->charge > cache->max_size && cache->heap_len > 0) {
+        cache_entry_t *victim = cache->heap[0];
+        cache->inflation = victim->priority;
+        entry_drop(cache, victim, DROP_CAPACITY);
+    }
+    return 0;
+}
+
+// Regista um acesso: atualiza a posição LRU e promove de probation para protected
+static void entry_touch(cache_t *cache, cache_entry_t *e) {
+    e->hits++;
+    if (e->heap_idx >= 0) {
+        e->priority = gdsf_priority(cache, e->hits, e->charge);
+        heap_sift_down(cache, e->heap_idx);
+    } else if (e->list == LIST_PROBATION) {
+        entry_move(cache, e, LIST_PROTECTED);
+        // Se a zona protected transbordar, os mais antigos voltam para probation
+        lru_list_t *protected = &cache->lists[LIST_PROTECTED];
+        while (protected->bytes > cache->protected_max && protected->count > 1) {
+            entry_move(cache, protected->tail, LIST_PROBATION);
+        }
+    } else {
+        entry_move(cache, e, e->list);
+    }
+}
+
+// Inicializa a cache com o tamanho máximo e o filtro de admissão configurados
+cache_t* cache_init(const server_config_t *config) {
+    if (!config) return NULL;
+
+    cache_t *cache = calloc(1, sizeof(cache_t));
     if (!cache) return NULL; // Se o malloc falhar retorna nulll
-    
-    cache->max_size = max_size_mb * 1024 * 1024;
-    cache->current_size = 0;
-    cache->max_entries = MAX_CACHE_ENTRIES;
-    cache->num_entries = 0;
-    cache->entries = malloc(sizeof(cache_entry_t) * MAX_CACHE_ENTRIES);
-    
-    if (!cache->entries) {
+
+    cache->max_size = (size_t)config->cache_size_mb * 1024 * 1024;
+    cache->max_limit = cache->max_size;
+    if (config->cache_adaptive && config->cache_max_size_mb > config->cache_size_mb) {
+        cache->max_limit = (size_t)config->cache_max_size_mb * 1024 * 1024;
+    }
+    cache->window_max = cache->max_size * WINDOW_PERCENT / 100;
+    cache->protected_max = (cache->max_size - cache->window_max) * PROTECTED_PERCENT / 100;
+    cache->max_object = (size_t)config->cache_max_object_kb * 1024;
+    cache->segment_size = (size_t)config->cache_segment_kb * 1024;
+    if (cache->segment_size > cache->max_object) cache->segment_size = cache->max_object;
+    cache->admission = config->cache_admission;
+    cache->policy = config->cache_policy;
+
+    // Slots do L1: potência de 2 até L1_MAX_SLOTS
+    cache->l1_mask = -1;
+    if (config->cache_l1_slots > 0) {
+        int slots = 1;
+        while (slots * 2 <= config->cache_l1_slots && slots * 2 <= L1_MAX_SLOTS) slots *= 2;
+        cache->l1_mask = slots - 1;
+    }
+
+    if (sketch_init(&cache->sketch, cache->max_limit) != 0) {
         free(cache);
         return NULL;
     }
-    
+
+    // Arena pré-alocada com o tamanho do orçamento: a memória da cache fica limitada à partida
+    // (com CACHE_ADAPTIVE, reserva o teto; só as páginas usadas ocupam RAM)
+    if (config->cache_arena) {
+        cache->arena = slab_init(cache->max_limit, config->cache_hugepages);
+        if (!cache->arena) {
+            free(cache->sketch.table);
+            free(cache);
+            return NULL;
+        }
+    }
+
 // Inicializa o lock e verifica se correu bem.
-    if (pthread_rwlock_init(&cache->rwlock, NULL) != 0) {
-        free(cache->entries);
+    if (pthread_rwlock_init(&cache->rwlock, NULL) != 0 ||
+        pthread_mutex_init(&cache->arena_lock, NULL) != 0 ||
+        pthread_mutex_init(&cache->fill_lock, NULL) != 0) {
+        slab_destroy(cache->arena);
+        free(cache->sketch.table);
         free(cache);
         return NULL;
     }
-    
+
     return cache;
 }
 
 cache_entry_t* cache_get(cache_t *cache, const char *key) {
+    return cache_get_segment(cache, key, CACHE_WHOLE_FILE, 0);
+}
+
+// O que um acesso conta para o sketch de frequências e para os contadores de hits/misses
+#define LOOKUP_QUIET 0  // Nada (re-verificação de um acesso já contado)
+#define LOOKUP_RECORD 1 // Hit ou miss
+#define LOOKUP_HITS 2   // Só um hit; o miss é contado por quem for a seguir ao disco
+
+// Procura e reserva a entrada
+static cache_entry_t* cache_lookup(cache_t *cache, const char *key, long segment, uint64_t tag, int record) {
+    uint64_t hash = hash_segment(key, segment);
+
+    // Lock de escrita: um hit altera a ordem LRU e o sketch de frequências
+    pthread_rwlock_wrlock(&cache->rwlock);
+
+    cache->l1_hits += l1_hits_pending;
+    l1_hits_pending = 0;
+
+    cache_entry_t *e = hash_lookup(cache, key, segment, hash);
+    if (e && e->tag != tag) {
+        // Segmento de uma versão antiga do ficheiro
+        entry_drop(cache, e, DROP_STALE);
+        e = NULL;
+    }
+    if (e) {
+        entry_touch(cache, e);
+        __sync_fetch_and_add(&e->refs, 1);
+    }
+    // Todos os acessos contados (hits e misses) entram na frequência
+    if (record == LOOKUP_RECORD || (e && record == LOOKUP_HITS)) {
+        sketch_increment(&cache->sketch, hash);
+        if (e) cache->hits++; else cache->misses++;
+    }
+
+    pthread_rwlock_unlock(&cache->rwlock);
+    return e;
+}
+
+cache_entry_t* cache_get_segment(cache_t *cache, const char *key, long segment, uint64_t tag) {
     if (!cache || !key) return NULL;
-    
-    // Bloqueia para leitura. Várias threads podem ler ao mesmo tempo
-    pthread_rwlock_rdlock(&cache->rwlock);
-    
-    for (int i = 0; i < cache->num_entries; i++) {
-        if (cache->entries[i].key && strcmp(cache->entries[i].key, key) == 0) {
-            //  Liberta o lock de leitura para adquirir o de escrita e atualizar o timestamp.
-            pthread_rwlock_unlock(&cache->rwlock);
-            
-            pthread_rwlock_wrlock(&cache->rwlock);
-            cache->entries[i].accessed = time(NULL); // Atualiza acesso (para o LRU)
-            pthread_rwlock_unlock(&cache->rwlock);
-            
-            return &cache->entries[i];
+    return cache_lookup(cache, key, segment, tag, LOOKUP_RECORD);
+}
+
+void cache_release(cache_entry_t *entry) {
+    if (!entry) return;
+    // Emprestada pelo L1 desta thread: não há referência a largar
+    cache_t *cache = entry->owner;
+    if (cache->l1_mask >= 0) {
+        l1_slot_t *slot = &l1[entry->hash & cache->l1_mask];
+        if (slot->entry == entry && slot->borrowed > 0) {
+            slot->borrowed--;
+            return;
         }
     }
-    pthread_rwlock_unlock(&cache->rwlock);
-    return NULL;
+    entry_unref(entry);
 }
 
-// Encontra o índice da entrada menos usada recentemente
-static int find_lru_entry(cache_t *cache) {
-    int lru_idx = 0;
-    time_t oldest = cache->entries[0].accessed;
-    
-    // Tenta linear pelo timestamp mais antigo
-    for (int i = 1; i < cache->num_entries; i++) {
-        if (cache->entries[i].accessed < oldest) {
-            oldest = cache->entries[i].accessed;
-            lru_idx = i;
+// Hit no L1 desta thread: sem lock e sem tocar no contador de referências
+static cache_entry_t* l1_lookup(cache_t *cache, const char *key, long segment, uint64_t tag, uint64_t hash) {
+    if (cache->l1_mask < 0) return NULL;
+    l1_slot_t *slot = &l1[hash & cache->l1_mask];
+    cache_entry_t *e = slot->entry;
+    if (!e || slot->owner != cache) return NULL;
+    if (e->hash != hash || e->segment != segment || e->tag != tag || strcmp(e->key, key) != 0) return NULL;
+
+    if (__atomic_load_n(&e->gen, __ATOMIC_ACQUIRE) != slot->gen) {
+        // Já saiu da cache: o L1 larga a sua referência
+        if (slot->borrowed == 0) {
+            slot->entry = NULL;
+            entry_unref(e);
         }
+        return NULL;
+    }
+
+    // De vez em quando vai à cache partilhada para que a recência e a frequência reflitam o uso real
+    if (++slot->uses % L1_REFRESH == 0) return NULL;
+
+    slot->borrowed++;
+    l1_hits_pending++;
+    return e;
+}
+
+// Guarda no L1 uma entrada acabada de reservar na cache partilhada
+static void l1_store(cache_t *cache, cache_entry_t *e) {
+    if (cache->l1_mask < 0 || e->size > L1_MAX_OBJECT) return;
+    l1_slot_t *slot = &l1[e->hash & cache->l1_mask];
+    if (slot->entry == e || slot->borrowed > 0) return;
+
+    uint64_t gen = __atomic_load_n(&e->gen, __ATOMIC_ACQUIRE);
+    if (gen == 0) return;
+
+    if (slot->entry) entry_unref(slot->entry);
+    __sync_fetch_and_add(&e->refs, 1);
+    slot->owner = cache;
+    slot->entry = e;
+    slot->gen = gen;
+    slot->uses = 0;
+}
+
+void cache_l1_flush(cache_t *cache) {
+    if (!cache) return;
+    for (int i = 0; i < L1_MAX_SLOTS; i++) {
+        l1_slot_t *slot = &l1[i];
+        if (slot->owner != cache || !slot->entry) continue;
+        if (slot->borrowed == 0) entry_unref(slot->entry);
+        slot->entry = NULL;
+        slot->owner = NULL;
     }
-    return lru_idx;
 }
 
 // Adiciona ou atualiza a entrada. Precisa de lock de escrita exclusivo
 void cache_put(cache_t *cache, const char *key, void *data, size_t size) {
-    if (!cache || !key || !data) return;
-    
+    cache_put_segment(cache, key, CACHE_WHOLE_FILE, 0, data, size);
+}
+
+// Insere a entrada. Com "acquire", devolve-a já reservada (NULL se foi recusada).
+static cache_entry_t* cache_insert(cache_t *cache, const char *key, long segment, uint64_t tag,
+                                   void *data, size_t size, int acquire) {
+    if (!cache || !key || !data) return NULL;
+    if (size > cache->max_size || size > cache->max_object) {
+        __sync_fetch_and_add(&cache->size_rejects, 1);
+        return NULL;
+    }
+
+    // Reserva o bloco (com arena precisa do lock para poder expulsar) e copia fora do lock
+    uint64_t hash = hash_segment(key, segment);
+    cache_entry_t *e;
+    if (cache->arena) {
+        pthread_rwlock_wrlock(&cache->rwlock);
+        e = entry_alloc(cache, key, hash, size);
+        pthread_rwlock_unlock(&cache->rwlock);
+    } else {
+        e = entry_alloc(cache, key, hash, size);
+    }
+    if (!e) return NULL;
+    memcpy(e->data, data, size);
+    e->segment = segment;
+    e->tag = tag;
+    e->refs = 1;
+    e->list = LIST_NONE;
+    e->heap_idx = -1;
+    e->hits = 1;
+
     pthread_rwlock_wrlock(&cache->rwlock);
-    
-    // Verifica se a chave já existe
-    for (int i = 0; i < cache->num_entries; i++) {
-        if (cache->entries[i].key && strcmp(cache->entries[i].key, key) == 0) {
-            // Atualiza a entrada existente 
-            cache->current_size -= cache->entries[i].size;
-            free(cache->entries[i].data); // Liberta os dados antigos
-            
-            cache->entries[i].data = malloc(size);
-            if (!cache->entries[i].data) {
-                pthread_rwlock_unlock(&cache->rwlock); // Evitar deadlock se falhar
-                return;
-            }
-            
-            memcpy(cache->entries[i].data, data, size);
-            cache->entries[i].size = size;
-            cache->entries[i].accessed = time(NULL);
-            cache->current_size += size;
+    e->gen = ++cache->next_gen;
+
+    // Se a chave já existir, a versão antiga sai da cache
+    cache_entry_t *old = hash_lookup(cache, key, segment, e->hash);
+    if (old) entry_drop(cache, old, DROP_STALE);
+
+    if (cache->policy == CACHE_POLICY_GDSF) {
+        e->priority = gdsf_priority(cache, e->hits, e->charge);
+        if (gdsf_make_room(cache, e) != 0 || heap_push(cache, e) != 0) {
+            cache->admission_rejects++;
             pthread_rwlock_unlock(&cache->rwlock);
-            return;
+            entry_free(e);
+            return NULL;
         }
+    } else {
+        // Nova entrada entra sempre pela janela
+        e->list = LIST_WINDOW;
+        list_push_head(&cache->lists[LIST_WINDOW], e);
     }
-    
-    // Se for nova entrada, verifica limites
-    if (cache->num_entries < cache->max_entries) {
-        // Se o tamanho exceder o máximo, remove o mais antigo (LRU)
-        while (cache->current_size + size > cache->max_size && cache->num_entries > 0) {
-            int lru_idx = find_lru_entry(cache);
-            
-            // Remove a entrada LRU
-            cache->current_size -= cache->entries[lru_idx].size;
-            free(cache->entries[lru_idx].key);
-            free(cache->entries[lru_idx].data);
-            cache->entries[lru_idx].key = NULL;
-            
-            // Move o último elemento para a posição vazia para manter o array contínuo
-            if (lru_idx != cache->num_entries - 1) {
-                cache->entries[lru_idx] = cache->entries[cache->num_entries - 1];
-            }
-            cache->num_entries--;
-        }
-        
-        // Finalmente, adiciona a nova entrada se houver espaço 
-        if (cache->current_size + size <= cache->max_size) {
-            cache->entries[cache->num_entries].key = malloc(strlen(key) + 1);
-            if (!cache->entries[cache->num_entries].key) {
-                pthread_rwlock_unlock(&cache->rwlock);
-                return;
-            }
-            
-            strcpy(cache->entries[cache->num_entries].key, key);
-            cache->entries[cache->num_entries].data = malloc(size);
-            if (!cache->entries[cache->num_entries].data) {
-                free(cache->entries[cache->num_entries].key); // Limpa a chave se falhar a alocação dos dados
-                pthread_rwlock_unlock(&cache->rwlock);
-                return;
+
+    cache_entry_t **bucket = &cache->buckets[e->hash & (CACHE_HASH_BUCKETS - 1)];
+    e->hnext = *bucket;
+    *bucket = e;
+    cache->current_size += e->charge;
+    cache->data_size += e->size;
+    cache->num_entries++;
+
+    // Reserva antes de aplicar a política: a própria entrada pode ser recusada pela admissão
+    if (acquire) __sync_fetch_and_add(&e->refs, 1);
+    if (cache->policy != CACHE_POLICY_GDSF) evict_overflow(cache);
+
+    if (acquire && e->list == LIST_NONE && e->heap_idx < 0) {
+        entry_unref(e);
+        e = NULL;
+    }
+
+    pthread_rwlock_unlock(&cache->rwlock);
+    return acquire ? e : NULL;
+}
+
+void cache_put_segment(cache_t *cache, const char *key, long segment, uint64_t tag, void *data, size_t size) {
+    cache_insert(cache, key, segment, tag, data, size, 0);
+}
+
+// Larga o fill (chamado com fill_lock). O último a sair liberta-o.
+static void fill_put(cache_fill_t *fill) {
+    if (--fill->users > 0) return;
+    if (fill->entry) entry_unref(fill->entry);
+    pthread_cond_destroy(&fill->cond);
+    free(fill->key);
+    free(fill);
+}
+
+cache_entry_t* cache_acquire(cache_t *cache, const char *key, cache_fill_t **fill) {
+    return cache_acquire_segment(cache, key, CACHE_WHOLE_FILE, 0, fill);
+}
+
+// L1 desta thread e depois a cache partilhada (guardando o hit no L1)
+static cache_entry_t* find_hit(cache_t *cache, const char *key, long segment, uint64_t tag, int record) {
+    cache_entry_t *e = l1_lookup(cache, key, segment, tag, hash_segment(key, segment));
+    if (e) {
+        PROBE_CACHE_HIT(key, segment, e->size, 1);
+        return e;
+    }
+
+    e = cache_lookup(cache, key, segment, tag, record);
+    if (e) {
+        PROBE_CACHE_HIT(key, segment, e->size, 0);
+        l1_store(cache, e);
+    }
+    return e;
+}
+
+cache_entry_t* cache_find(cache_t *cache, const char *key) {
+    if (!cache || !key) return NULL;
+    return find_hit(cache, key, CACHE_WHOLE_FILE, 0, LOOKUP_HITS);
+}
+
+cache_entry_t* cache_acquire_segment(cache_t *cache, const char *key, long segment, uint64_t tag, cache_fill_t **fill) {
+    *fill = NULL;
+    if (!cache || !key) return NULL;
+
+    cache_entry_t *e = find_hit(cache, key, segment, tag, LOOKUP_RECORD);
+    if (e) return e;
+    PROBE_CACHE_MISS(key, segment);
+
+    pthread_mutex_lock(&cache->fill_lock);
+
+    cache_fill_t *f = cache->fills;
+    while (f && !(f->segment == segment && f->tag == tag && strcmp(f->key, key) == 0)) f = f->next;
+
+    if (f) {
+        // Já há quem esteja a carregar: espera pelo resultado em vez de ir ao disco
+        f->users++;
+        while (!f->done) pthread_cond_wait(&f->cond, &cache->fill_lock);
+        e = f->entry;
+        if (e) __sync_fetch_and_add(&e->refs, 1);
+        fill_put(f);
+        pthread_mutex_unlock(&cache->fill_lock);
+        return e;
+    }
+
+    // O fill anterior pode ter terminado entre o miss e o lock
+    e = cache_lookup(cache, key, segment, tag, LOOKUP_QUIET);
+    if (!e && (f = calloc(1, sizeof(cache_fill_t))) != NULL) {
+        f->key = strdup(key);
+        if (!f->key || pthread_cond_init(&f->cond, NULL) != 0) {
+            free(f->key);
+            free(f);
+        } else {
+            f->segment = segment;
+            f->tag = tag;
+            f->users = 1;
+            clock_gettime(CLOCK_MONOTONIC, &f->start);
+            f->next = cache->fills;
+            cache->fills = f;
+            *fill = f;
+        }
+    }
+
+    pthread_mutex_unlock(&cache->fill_lock);
+    return e;
+}
+
+// Termina o fill: acorda quem espera e larga a referência do líder
+static cache_entry_t* fill_finish(cache_t *cache, cache_fill_t *fill, cache_entry_t *e) {
+    pthread_mutex_lock(&cache->fill_lock);
+
+    cache_fill_t **pp = &cache->fills;
+    while (*pp && *pp != fill) pp = &(*pp)->next;
+    if (*pp) *pp = fill->next;
+
+    fill->entry = e;
+    fill->done = 1;
+    if (e) __sync_fetch_and_add(&e->refs, 1); // Referência devolvida ao líder
+    pthread_cond_broadcast(&fill->cond);
+    fill_put(fill);
+
+    pthread_mutex_unlock(&cache->fill_lock);
+    return e;
+}
+
+cache_entry_t* cache_fill_complete(cache_t *cache, cache_fill_t *fill, void *data, size_t size) {
+    if (!cache || !fill) return NULL;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t us = (now.tv_sec - fill->start.tv_sec) * 1000000 + (now.tv_nsec - fill->start.tv_nsec) / 1000;
+    __sync_fetch_and_add(&cache->fill_count, 1);
+    __sync_fetch_and_add(&cache->fill_time_us, us);
+
+    cache_entry_t *e = cache_insert(cache, fill->key, fill->segment, fill->tag, data, size, 1);
+    return fill_finish(cache, fill, e);
+}
+
+void cache_fill_abort(cache_t *cache, cache_fill_t *fill) {
+    if (!cache || !fill) return;
+    fill_finish(cache, fill, NULL);
+}
+
+typedef struct {
+    char *key;
+    size_t size;
+    uint32_t hits;
+} snapshot_item_t;
+
+static int snapshot_cmp(const void *a, const void *b) {
+    const snapshot_item_t *x = a, *y = b;
+    return (x->hits < y->hits) - (x->hits > y->hits); // Mais acessados primeiro
+}
+
+// Grava "hits tamanho mtime caminho" por entrada, dos mais acessados para os menos.
+// Escreve para um ficheiro temporário e faz rename para nunca deixar um snapshot a meio.
+int cache_snapshot_save(cache_t *cache, const char *filename) {
+    if (!cache || !filename) return -1;
+
+    // Copia a lista sob o lock de leitura; o stat e a escrita são feitos depois
+    pthread_rwlock_rdlock(&cache->rwlock);
+    int n = 0;
+    snapshot_item_t *items = malloc((cache->num_entries + 1) * sizeof(snapshot_item_t));
+    if (items) {
+        for (int b = 0; b < CACHE_HASH_BUCKETS; b++) {
+            for (cache_entry_t *e = cache->buckets[b]; e; e = e->hnext) {
+                if (e->segment != CACHE_WHOLE_FILE) continue; // Segmentos são recarregados a pedido
+                items[n].key = strdup(e->key);
+                if (!items[n].key) continue;
+                items[n].size = e->size;
+                items[n].hits = e->hits;
+                n++;
             }
-            
-            memcpy(cache->entries[cache->num_entries].data, data, size);
-            cache->entries[cache->num_entries].size = size;
-            cache->entries[cache->num_entries].accessed = time(NULL);
-            
-            cache->current_size += size;
-            cache->num_entries++;
         }
     }
-    
+    pthread_rwlock_unlock(&cache->rwlock);
+    if (!items) return -1;
+
+    qsort(items, n, sizeof(snapshot_item_t), snapshot_cmp);
+
+    char tmp[1024];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", filename);
+    FILE *f = fopen(tmp, "w");
+    if (f) {
+        fprintf(f, "# cache snapshot v1: hits size mtime path\n");
+        for (int i = 0; i < n; i++) {
+            struct stat st;
+            // Guarda o mtime atual: no arranque só se aquece o que não mudou desde então
+            if (stat(items[i].key, &st) != 0 || (size_t)st.st_size != items[i].size) continue;
+            fprintf(f, "%u %zu %ld %s\n", items[i].hits, items[i].size, (long)st.st_mtime, items[i].key);
+        }
+    }
+
+    for (int i = 0; i < n; i++) free(items[i].key);
+    free(items);
+
+    if (!f) return -1;
+    if (fclose(f) != 0 || rename(tmp, filename) != 0) {
+        remove(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+// Lê o snapshot e carrega os ficheiros que não mudaram, até encher o orçamento.
+// "stop" permite abortar a meio (shutdown do worker). Devolve o número de ficheiros carregados.
+int cache_snapshot_load(cache_t *cache, const char *filename, volatile int *stop) {
+    if (!cache || !filename) return -1;
+
+    FILE *f = fopen(filename, "r");
+    if (!f) return -1;
+
+    char line[1280], path[1024];
+    size_t loaded_bytes = 0;
+    int loaded = 0;
+
+    while (fgets(line, sizeof(line), f) && !(stop && *stop)) {
+        unsigned hits;
+        size_t size;
+        long mtime;
+        if (line[0] == '#' || sscanf(line, "%u %zu %ld %1023[^\n]", &hits, &size, &mtime, path) != 4) continue;
+        if (loaded_bytes + size > cache->max_size) break;
+
+        struct stat st;
+        if (stat(path, &st) != 0 || (long)st.st_mtime != mtime || (size_t)st.st_size != size) continue;
+        if (size > cache->max_object) continue;
+
+        FILE *src = fopen(path, "rb");
+        if (!src) continue;
+        void *data = malloc(size ? size : 1);
+        if (data && fread(data, 1, size, src) == size) {
+            // Repõe a frequência conhecida para o filtro de admissão não recusar o hot set
+            uint64_t hash = hash_key(path);
+            pthread_rwlock_wrlock(&cache->rwlock);
+            for (unsigned i = 0; i < hits && i < SKETCH_MAX_COUNT; i++) sketch_increment(&cache->sketch, hash);
+            pthread_rwlock_unlock(&cache->rwlock);
+
+            cache_put(cache, path, data, size);
+            loaded_bytes += size;
+            loaded++;
+        }
+        free(data);
+        fclose(src);
+    }
+
+    fclose(f);
+    return loaded;
+}
+
+// Muda o orçamento em tempo de execução. Ao encolher, expulsa logo o excesso e
+// devolve ao kernel as páginas da arena que ficaram livres.
+void cache_set_capacity(cache_t *cache, size_t bytes) {
+    if (!cache) return;
+    if (bytes > cache->max_limit) bytes = cache->max_limit;
+
+    pthread_rwlock_wrlock(&cache->rwlock);
+    cache->max_size = bytes;
+    cache->window_max = bytes * WINDOW_PERCENT / 100;
+    cache->protected_max = (bytes - cache->window_max) * PROTECTED_PERCENT / 100;
+
+    while (cache->current_size > cache->max_size) {
+        cache_entry_t *victim = pick_victim(cache);
+        if (!victim) break;
+        if (victim->heap_idx >= 0) cache->inflation = victim->priority;
+        entry_drop(cache, victim, DROP_RESIZE);
+    }
+    if (cache->policy != CACHE_POLICY_GDSF) {
+        evict_overflow(cache);
+        lru_list_t *protected = &cache->lists[LIST_PROTECTED];
+        while (protected->bytes > cache->protected_max && protected->count > 1) {
+            entry_move(cache, protected->tail, LIST_PROBATION);
+        }
+    }
+
+    if (cache->arena) {
+        pthread_mutex_lock(&cache->arena_lock);
+        slab_trim(cache->arena);
+        pthread_mutex_unlock(&cache->arena_lock);
+    }
     pthread_rwlock_unlock(&cache->rwlock);
 }
 
-/// Retorna o ponteiro para os dados 
+size_t cache_capacity(cache_t *cache) {
+    if (!cache) return 0;
+    pthread_rwlock_rdlock(&cache->rwlock);
+    size_t bytes = cache->max_size;
+    pthread_rwlock_unlock(&cache->rwlock);
+    return bytes;
+}
+
+int cache_admits_size(cache_t *cache, size_t size) {
+    if (!cache) return 0;
+    if (size <= cache->max_object) return 1;
+    __sync_fetch_and_add(&cache->size_rejects, 1);
+    return 0;
+}
+
+void cache_get_stats(cache_t *cache, cache_stats_t *out) {
+    if (!cache || !out) return;
+    pthread_rwlock_rdlock(&cache->rwlock);
+    out->hits = cache->hits + cache->l1_hits;
+    out->l1_hits = cache->l1_hits;
+    out->misses = cache->misses;
+    out->evictions_capacity = cache->drops[DROP_CAPACITY];
+    out->evictions_stale = cache->drops[DROP_STALE];
+    out->evictions_resize = cache->drops[DROP_RESIZE];
+    out->admission_rejects = cache->admission_rejects + cache->drops[DROP_REJECTED];
+    out->bytes_used = cache->current_size;
+    out->bytes_budget = cache->max_size;
+    out->entries = cache->num_entries;
+    out->data_bytes = cache->data_size;
+    out->meta_bytes = cache->current_size - cache->data_size + sizeof(cache_t) +
+                      (size_t)SKETCH_DEPTH * (cache->sketch.width_mask + 1) +
+                      (size_t)cache->heap_cap * sizeof(cache_entry_t*);
+    pthread_rwlock_unlock(&cache->rwlock);
+
+    out->size_rejects = __atomic_load_n(&cache->size_rejects, __ATOMIC_RELAXED);
+    out->fills = __atomic_load_n(&cache->fill_count, __ATOMIC_RELAXED);
+    out->fill_time_us = __atomic_load_n(&cache->fill_time_us, __ATOMIC_RELAXED);
+    out->reserved_bytes = slab_footprint(cache->arena); // Fixo desde o cache_init
+}
+
+// Maior objeto que a cache aceita (CACHE_MAX_OBJECT_KB)
+size_t cache_max_object_size(cache_t *cache) {
+    return cache ? cache->max_object : 0;
+}
+
+// Tamanho dos segmentos usados para ficheiros grandes (0 se desligado)
+size_t cache_segment_size(cache_t *cache) {
+    return cache ? cache->segment_size : 0;
+}
+
+/// Retorna o ponteiro para os dados
 void* cache_entry_get_data(cache_entry_t *entry) {
     if (!entry) return NULL;
     return entry->data;
 }
 
-// Retorna o tamanho da entrada 
+// Retorna o tamanho da entrada
 size_t cache_entry_get_size(cache_entry_t *entry) {
     if (!entry) return 0;
     return entry->size;
@@ -175,22 +1101,22 @@ size_t cache_entry_get_size(cache_entry_t *entry) {
 // "Destrói" a cache e liberta todos os recursos
 void cache_destroy(cache_t *cache) {
     if (!cache) return;
-    
+    cache_l1_flush(cache);
+
     // Garante que ninguém está a usar a cache antes de a "destruir"
     pthread_rwlock_wrlock(&cache->rwlock);
-    
-    for (int i = 0; i < cache->num_entries; i++) {
-        if (cache->entries[i].key) {
-            free(cache->entries[i].key);
-        }
-        if (cache->entries[i].data) {
-            free(cache->entries[i].data);
-        }
+
+    for (int i = 0; i < CACHE_HASH_BUCKETS; i++) {
+        while (cache->buckets[i]) entry_drop(cache, cache->buckets[i], DROP_DESTROY);
     }
-    
+
     pthread_rwlock_unlock(&cache->rwlock);
     pthread_rwlock_destroy(&cache->rwlock);
-    
-    free(cache->entries);
+
+    pthread_mutex_destroy(&cache->fill_lock);
+    pthread_mutex_destroy(&cache->arena_lock);
+    slab_destroy(cache->arena);
+    free(cache->heap);
+    free(cache->sketch.table);
     free(cache);
-}
\ No newline at end of file
+}
@@ -2,21 +2,87 @@
 #define CACHE_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include <pthread.h>
+#include "config.h"
+#include "stats.h"
+
+// Índice de segmento usado pelas entradas que guardam o ficheiro inteiro
+#define CACHE_WHOLE_FILE (-1L)
 
 // Tipos opacos.
 typedef struct cache cache_t;
 typedef struct cache_entry cache_entry_t;
+typedef struct cache_fill cache_fill_t;
 
-// Inicializa a estrutura da cache
-cache_t* cache_init(size_t max_size_mb);
+// Inicializa a estrutura da cache (tamanho e política vêm da configuração)
+cache_t* cache_init(const server_config_t *config);
 
-// Tenta encontrar uma entrada na cache através da chave
+// Tenta encontrar uma entrada na cache através da chave.
+// A entrada devolvida fica reservada até ser chamada cache_release().
 cache_entry_t* cache_get(cache_t *cache, const char *key);
 
-// Adiciona um novo item à cache. Se a chave já existir, atualiza os dados e o tamanho
+// Ficheiros grandes são guardados por segmentos alinhados, com chave (caminho, índice).
+// "tag" identifica a versão do ficheiro (mtime/tamanho): um segmento de outra versão é um miss.
+cache_entry_t* cache_get_segment(cache_t *cache, const char *key, long segment, uint64_t tag);
+void cache_put_segment(cache_t *cache, const char *key, long segment, uint64_t tag, void *data, size_t size);
+
+// Como cache_get, mas com single-flight: num miss, se outra thread já estiver a carregar
+// a mesma chave, espera e devolve o resultado dela (ou NULL se ela não o conseguiu guardar).
+// Se for a primeira, *fill fica preenchido e a thread tem de chamar cache_fill_complete
+// ou cache_fill_abort depois de ler o ficheiro.
+cache_entry_t* cache_acquire(cache_t *cache, const char *key, cache_fill_t **fill);
+cache_entry_t* cache_acquire_segment(cache_t *cache, const char *key, long segment, uint64_t tag, cache_fill_t **fill);
+
+// Só o hit: num miss devolve NULL sem o contar nem criar um fill (quem chama decide se
+// o ficheiro vai para a cache, por exemplo depois de ver o tamanho, e usa então cache_acquire)
+cache_entry_t* cache_find(cache_t *cache, const char *key);
+
+// Guarda os dados lidos pelo líder, acorda quem espera e devolve a entrada reservada
+// (NULL se a cache a recusou)
+cache_entry_t* cache_fill_complete(cache_t *cache, cache_fill_t *fill, void *data, size_t size);
+
+// O líder não conseguiu carregar: acorda quem espera sem resultado
+void cache_fill_abort(cache_t *cache, cache_fill_t *fill);
+
+// Liberta a reserva obtida com cache_get
+void cache_release(cache_entry_t *entry);
+
+// cache_acquire consulta primeiro um pequeno L1 da própria thread (CACHE_L1_SLOTS entradas),
+// que devolve os objetos mais quentes sem locks nem escritas partilhadas. Cada thread
+// tem de chamar isto antes de terminar para largar as entradas que o L1 retém.
+void cache_l1_flush(cache_t *cache);
+
+// Adiciona um novo item à cache. Se a chave já existir, atualiza os dados e o tamanho.
+// Com o filtro TinyLFU ativo, o item pode ser recusado se for menos frequente que a vítima.
+// Com CACHE_POLICY=GDSF, as vítimas são as entradas com menos hits por byte.
 void cache_put(cache_t *cache, const char *key, void *data, size_t size);
 
+// Grava a lista de entradas (hits, tamanho, mtime, caminho) ordenada por acessos
+int cache_snapshot_save(cache_t *cache, const char *filename);
+
+// Pré-carrega os ficheiros de um snapshot que não mudaram desde que foi gravado.
+// Pára se *stop ficar a 1. Devolve o número de ficheiros carregados ou -1.
+int cache_snapshot_load(cache_t *cache, const char *filename, volatile int *stop);
+
+// Muda o orçamento (limitado ao teto definido no arranque), expulsando o que não couber
+void cache_set_capacity(cache_t *cache, size_t bytes);
+
+// Orçamento atual
+size_t cache_capacity(cache_t *cache);
+
+// 1 se um objeto deste tamanho pode entrar na cache; se não, conta-o como recusado por tamanho
+int cache_admits_size(cache_t *cache, size_t size);
+
+// Contadores da cache (hits, misses, expulsões por motivo, ocupação, tempo de fill)
+void cache_get_stats(cache_t *cache, cache_stats_t *out);
+
+// Maior objeto que a cache aceita (CACHE_MAX_OBJECT_KB)
+size_t cache_max_object_size(cache_t *cache);
+
+// Tamanho dos segmentos usados para ficheiros grandes (CACHE_SEGMENT_KB, 0 se desligado)
+size_t cache_segment_size(cache_t *cache);
+
 // Função auxiliar para aceder aos dados da entrada
 void* cache_entry_get_data(cache_entry_t *entry);
 
@@ -26,4 +92,4 @@ size_t cache_entry_get_size(cache_entry_t *entry);
 // Limpa toda a memória alocada e destrói os locks/recursos associados
 void cache_destroy(cache_t *cache);
 
-#endif
\ No newline at end of file
+#endif
@@ -2,6 +2,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+
+// Aceita ON/YES/TRUE/1 como verdadeiro
+static int parse_bool(const char* value) {
+    return strcasecmp(value, "ON") == 0 || strcasecmp(value, "YES") == 0 ||
+           strcasecmp(value, "TRUE") == 0 || strcmp(value, "1") == 0;
+}
 
 // Função que lê o ficheiro de configuração e preenche a struct
 int load_config(const char* filename, server_config_t* config) {
@@ -10,11 +17,39 @@ int load_config(const char* filename, server_config_t* config) {
 
     char line[512], key[128], value[256];
 
+    // Valores por omissão para as chaves opcionais
+    config->cache_admission = CACHE_ADMISSION_TINYLFU;
+    config->cache_policy = CACHE_POLICY_SLRU;
+    config->cache_max_object_kb = 1024;
+    config->cache_arena = 1;
+    config->cache_hugepages = 0;
+    config->cache_segment_kb = 256;
+    config->cache_snapshot_file[0] = '\0';
+    config->cache_snapshot_interval = 60;
+    config->preload = 0;
+    config->preload_files[0] = '\0';
+    config->preload_max_mb = 64;
+    config->cache_l1_slots = 64;
+    config->cache_adaptive = 0;
+    config->cache_min_size_mb = 2;
+    config->cache_max_size_mb = 0; // 0 = CACHE_SIZE_MB
+    config->negative_cache_ttl = 5;
+    config->docroot_filter = 1;
+    config->stats_stream_clients = 16;
+    config->slow_request_ms = 100;
+    config->trace_sample_rate = 0;
+    strcpy(config->trace_file, "trace.json");
+    config->tcp_info_sample_rate = 100;
+    config->perf_counters = 0;
+
     while (fgets(line, sizeof(line), fp)) {
         // Ignora linhas de comentários (#) ou linhas vazias
         if (line[0] == '#' || line[0] == '\n') continue;
 
         if (sscanf(line, "%[^=]=%s", key, value) == 2) {
+            // Valor vazio seguido de comentário (ex: "CHAVE= # ...")
+            if (value[0] == '#') value[0] = '\0';
+
             // Compara as chaves para saber onde guardar os valores na struct
             if (strcmp(key, "PORT") == 0)
                 config->port = atoi(value); // Converte string para int
@@ -33,6 +68,54 @@ int load_config(const char* filename, server_config_t* config) {
                 config->cache_size_mb = atoi(value);
             else if (strcmp(key, "TIMEOUT_SECONDS") == 0)
                 config->timeout_seconds = atoi(value);
+            else if (strcmp(key, "CACHE_ADMISSION") == 0)
+                config->cache_admission = (strcasecmp(value, "NONE") == 0) ?
+                    CACHE_ADMISSION_NONE : CACHE_ADMISSION_TINYLFU;
+            else if (strcmp(key, "CACHE_POLICY") == 0)
+                config->cache_policy = (strcasecmp(value, "GDSF") == 0) ?
+                    CACHE_POLICY_GDSF : CACHE_POLICY_SLRU;
+            else if (strcmp(key, "CACHE_MAX_OBJECT_KB") == 0)
+                config->cache_max_object_kb = atoi(value);
+            else if (strcmp(key, "CACHE_ARENA") == 0)
+                config->cache_arena = parse_bool(value);
+            else if (strcmp(key, "CACHE_HUGEPAGES") == 0)
+                config->cache_hugepages = parse_bool(value);
+            else if (strcmp(key, "CACHE_SEGMENT_KB") == 0)
+                config->cache_segment_kb = atoi(value);
+            else if (strcmp(key, "CACHE_SNAPSHOT_FILE") == 0)
+                strncpy(config->cache_snapshot_file, value, sizeof(config->cache_snapshot_file));
+            else if (strcmp(key, "CACHE_SNAPSHOT_INTERVAL") == 0)
+                config->cache_snapshot_interval = atoi(value);
+            else if (strcmp(key, "PRELOAD") == 0)
+                config->preload = parse_bool(value);
+            else if (strcmp(key, "PRELOAD_FILES") == 0)
+                strncpy(config->preload_files, value, sizeof(config->preload_files));
+            else if (strcmp(key, "PRELOAD_MAX_MB") == 0)
+                config->preload_max_mb = atoi(value);
+            else if (strcmp(key, "CACHE_L1_SLOTS") == 0)
+                config->cache_l1_slots = atoi(value);
+            else if (strcmp(key, "CACHE_ADAPTIVE") == 0)
+                config->cache_adaptive = parse_bool(value);
+            else if (strcmp(key, "CACHE_MIN_SIZE_MB") == 0)
+                config->cache_min_size_mb = atoi(value);
+            else if (strcmp(key, "CACHE_MAX_SIZE_MB") == 0)
+                config->cache_max_size_mb = atoi(value);
+            else if (strcmp(key, "NEGATIVE_CACHE_TTL") == 0)
+                config->negative_cache_ttl = atoi(value);
+            else if (strcmp(key, "DOCROOT_FILTER") == 0)
+                config->docroot_filter = parse_bool(value);
+            else if (strcmp(key, "STATS_STREAM_CLIENTS") == 0)
+                config->stats_stream_clients = atoi(value);
+            else if (strcmp(key, "SLOW_REQUEST_MS") == 0)
+                config->slow_request_ms = atoi(value);
+            else if (strcmp(key, "TRACE_SAMPLE_RATE") == 0)
+                config->trace_sample_rate = atoi(value);
+            else if (strcmp(key, "TRACE_FILE") == 0)
+                strncpy(config->trace_file, value, sizeof(config->trace_file));
+            else if (strcmp(key, "TCP_INFO_SAMPLE_RATE") == 0)
+                config->tcp_info_sample_rate = atoi(value);
+            else if (strcmp(key, "PERF_COUNTERS") == 0)
+                config->perf_counters = parse_bool(value);
         }
     }
     
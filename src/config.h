@@ -10,8 +10,37 @@ typedef struct {
     char log_file[256];
     int cache_size_mb;
     int timeout_seconds;
+    int cache_admission;     // Filtro de admissão da cache (CACHE_ADMISSION_*)
+    int cache_policy;        // Política de substituição (CACHE_POLICY_*)
+    int cache_max_object_kb; // Tamanho máximo de um ficheiro guardado em cache
+    int cache_arena;         // 1 = blocos da cache vêm de uma arena de slabs pré-alocada
+    int cache_hugepages;     // 1 = tenta reservar a arena com huge pages
+    int cache_segment_kb;    // Ficheiros acima do máximo são guardados em segmentos deste tamanho (0 = não)
+    char cache_snapshot_file[256]; // Snapshot do hot set (vazio = desligado); cada worker usa <ficheiro>.<id>
+    int cache_snapshot_interval;   // Segundos entre snapshots
+    int preload;                   // 1 = carrega ficheiros para memória antes do fork
+    char preload_files[256];       // Lista separada por vírgulas (vazia = toda a DOCUMENT_ROOT)
+    int preload_max_mb;            // Limite do pré-carregamento
+    int cache_l1_slots;            // Entradas do L1 de cada thread (0 = desligado)
+    int cache_adaptive;            // 1 = ajusta o orçamento à pressão de memória (cgroup/PSI)
+    int cache_min_size_mb;         // Limites do orçamento adaptativo
+    int cache_max_size_mb;
+    int negative_cache_ttl;        // Segundos que um 404 fica em cache (0 = desativado)
+    int docroot_filter;            // 1 = Bloom filter dos ficheiros da DOCUMENT_ROOT
+    int stats_stream_clients;      // Clientes do /stats/stream por worker (0 = desligado)
+    int slow_request_ms;           // Pedidos acima disto vão para o anel do /debug/slow (0 = desligado)
+    int trace_sample_rate;         // 1 em cada N pedidos vai para o trace (0 = desligado)
+    char trace_file[256];          // Cada worker escreve <ficheiro>.<id>
+    int tcp_info_sample_rate;      // 1 em cada N conexões lê TCP_INFO ao fechar (0 = desligado)
+    int perf_counters;             // 1 = contadores perf_event_open nas threads dos pedidos
 } server_config_t;
 
+#define CACHE_ADMISSION_NONE    0 // Admite tudo (só recência)
+#define CACHE_ADMISSION_TINYLFU 1 // W-TinyLFU: admissão por frequência
+
+#define CACHE_POLICY_SLRU 0 // Janela LRU + SLRU (só recência/frequência)
+#define CACHE_POLICY_GDSF 1 // Greedy-Dual-Size-Frequency: hits por byte
+
 // Lê o ficheiro e preenche a struct. Retorna -1 em caso de erro
 int load_config(const char* filename, server_config_t* config);
 
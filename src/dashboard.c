@@ -0,0 +1,371 @@
+#define _POSIX_C_SOURCE 200809L
+#include "dashboard.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <time.h>
+
+#define STREAM_POLL_MS 100 // Intervalo entre verificações de um JSON novo
+
+// Página única: os dados chegam pelo stream (ou por polling do /stats.json se o stream falhar)
+static const char g_page[] =
+    "<!DOCTYPE html><html><head><title>Monitor Completo</title>"
+    "<meta charset='UTF-8'>"
+    "<style>"
+    "body{font-family:'Segoe UI',sans-serif;padding:20px;background:#f0f2f5;color:#333;}"
+    ".grid{display:grid;grid-template-columns:repeat(auto-fit,minmax(300px,1fr));gap:20px;}"
+    ".card{background:white;padding:20px;border-radius:10px;box-shadow:0 2px 8px rgba(0,0,0,0.1);}"
+    "h1{text-align:center;color:#1a73e8;margin-bottom:30px;}"
+    "h2{font-size:1.1em;color:#5f6368;border-bottom:1px solid #eee;padding-bottom:10px;margin-top:0;}"
+    ".row{display:flex;justify-content:space-between;margin:8px 0;font-size:1.05em;}"
+    ".val{font-weight:bold;color:#1a73e8;}"
+    "#src{text-align:center;color:#888;font-size:0.9em;}"
+    "</style></head>"
+    "<body>"
+    "<h1>Dashboard do Servidor</h1>"
+    "<div class='grid' id='grid'></div>"
+    "<p id='src'>A ligar...</p>"
+    "<script>"
+    "function mb(b){return (b/1048576).toFixed(2);}"
+    "function pct(l){return l.p50+' / '+l.p90+' / '+l.p99+' / '+l.p999+' / '+l.max;}"
+    "function card(t,rows){var h=\"<div class='card'><h2>\"+t+'</h2>';"
+    "rows.forEach(function(r){h+=\"<div class='row'><span>\"+r[0]+\":</span> <span class='val'>\"+r[1]+'</span></div>';});"
+    "return h+'</div>';}"
+    "function spark(v){var m=Math.max.apply(null,v.concat([1]));"
+    "return v.map(function(x){return '▁▂▃▄▅▆▇█'.charAt(Math.min(7,Math.floor(8*x/m)));}).join('');}"
+    "function show(s){"
+    "function rates(f){return s.rates.map(f).join(' / ');}"
+    "var c=s.cache,look=c.hits+c.misses;"
+    "var h=card('Performance',[['Uptime',s.uptime+' s'],['Conexões Ativas',s.active],"
+    "['Fila de Accept',s.queue.depth+' / '+s.queue.limit],['Tempo Médio',s.latency.avg_ms.toFixed(2)+' ms'],"
+    "['p50 / p90 / p99 / p99.9 / max (us)',pct(s.latency)],['Últimos '+s.window+' (us)',pct(s.latency_window)]]);"
+    "h+=card('Etapas (média ms / p99 us)',Object.keys(s.stages).map(function(k){var t=s.stages[k];return [k,t.avg_ms.toFixed(3)+' / '+t.p99];})"
+    ".concat([['CPU / Total (média ms)',s.cpu.avg_ms.toFixed(3)+' / '+s.latency.avg_ms.toFixed(3)]]));"
+    "h+=card('Rede (TCP_INFO: amostras, RTT p50/p99 us, retransmitidas, por confirmar)',Object.keys(s.tcp).map(function(k){var t=s.tcp[k];"
+    "return [k,t.samples+', '+t.rtt.p50+' / '+t.rtt.p99+', '+t.retransmitted+', '+t.unacked];}));"
+    "h+=card('Tráfego',[['Total Pedidos',s.requests],"
+    "['Pedidos/s ('+rates(function(r){return r.window+'s';})+')',rates(function(r){return r.requests.toFixed(1);})],"
+    "['MB/s',rates(function(r){return mb(r.bytes);})],"
+    "['Erros 4xx / 5xx por s',rates(function(r){return r.classes[4].toFixed(1)+'|'+r.classes[5].toFixed(1);})],"
+    "['Últimos '+s.history.length+' s',spark(s.history)],['Dados Enviados',mb(s.bytes)+' MB']]);"
+    "h+=card('Códigos de Resposta',[['200 OK',s.status['200']],['403 Forbidden',s.status['403']],"
+    "['404 Not Found',s.status['404']],['500 Error',s.status['500']],['503 Busy',s.status['503']],"
+    "['2xx / 3xx / 4xx / 5xx',s.classes.slice(2).join(' / ')]]);"
+    "h+=card('Cache',[['Hit Rate',(look?100*c.hits/look:0).toFixed(1)+'%'],"
+    "['Hits (L1) / Misses',c.hits+' ('+c.l1_hits+') / '+c.misses],['Entradas',c.entries],"
+    "['Ocupado / Orçamento',mb(c.bytes)+' / '+mb(c.budget)+' MB'],"
+    "['Expulsões (espaço/versão/resize)',c.evictions.join(' / ')],['Recusados (admissão/tamanho)',c.rejects.join(' / ')],"
+    "['Fill Médio',(c.fills?c.fill_ms/c.fills:0).toFixed(2)+' ms']]);"
+    "function esc(t){return t.replace(/[&<>'\"]/g,function(ch){return '&#'+ch.charCodeAt(0)+';';});}"
+    "h+=card('Mais Pedidos (pedidos/s)',s.top_hits.map(function(p){return [esc(p.path),p.rate.toFixed(1)];}));"
+    "h+=card('Mais Bytes (KB/s)',s.top_bytes.map(function(p){return [esc(p.path),(p.rate/1024).toFixed(1)];}));"
+    "h+=card('Workers',s.workers.map(function(w,i){return ['Worker '+i,w.entries+' entradas, '+mb(w.bytes)+' / '+mb(w.budget)+' MB'];}));"
+    "h+=card('Processos (RSS, trocas/pedido, ciclos/pedido, IPC)',s.workers.map(function(w,i){return ['Worker '+i,"
+    "mb(w.rss)+' MB, '+w.switches_req.toFixed(2)+(w.perf==2?', '+w.cycles_req.toFixed(0)+', '+w.ipc.toFixed(2):'')];}));"
+    "h+=card('Memória (MB: cache dados/meta, conexões, log, heap usado/livre)',s.workers.map(function(w,i){var m=w.mem;"
+    "return ['Worker '+i,mb(m.cache_data)+' / '+mb(m.cache_meta)+', '+mb(m.conn)+', '+mb(m.log)+', '+mb(m.heap_in_use+m.heap_mmap)+' / '+mb(m.heap_free)];})"
+    ".concat([['Alocações por pedido (média / bytes / máx)',s.allocs.per_request.toFixed(1)+' / '+s.allocs.bytes_per_request+' / '+s.allocs.max]]));"
+    "document.getElementById('grid').innerHTML=h;}"
+    "function poll(){document.getElementById('src').textContent='/stats.json (2 s)';"
+    "fetch('/stats.json',{cache:'no-store'}).then(function(r){return r.json();}).then(show).catch(function(){})"
+    ".then(function(){setTimeout(poll,2000);});}"
+    "if(window.EventSource){var es=new EventSource('/stats/stream');"
+    "es.onopen=function(){document.getElementById('src').textContent='/stats/stream (1 s)';};"
+    "es.onmessage=function(e){show(JSON.parse(e.data));};"
+    "es.onerror=function(){es.close();poll();};}else{poll();}"
+    "</script></body></html>";
+
+static char g_etag[24];
+static pthread_once_t g_etag_once = PTHREAD_ONCE_INIT;
+
+static void etag_init(void) {
+    // FNV-1a do conteúdo: muda sempre que a página muda
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < sizeof(g_page) - 1; i++) {
+        h ^= (unsigned char)g_page[i];
+        h *= 1099511628211ULL;
+    }
+    snprintf(g_etag, sizeof(g_etag), "\"%016lx\"", h);
+}
+
+const char* dashboard_page(size_t *len, const char **etag) {
+    pthread_once(&g_etag_once, etag_init);
+    *len = sizeof(g_page) - 1;
+    *etag = g_etag;
+    return g_page;
+}
+
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t cap;
+} json_t;
+
+static void json_printf(json_t *j, const char *fmt, ...) {
+    if (j->len >= j->cap) return;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(j->buf + j->len, j->cap - j->len, fmt, ap);
+    va_end(ap);
+    j->len = (n < 0) ? j->cap : j->len + n; // len >= cap marca truncado
+}
+
+// Caminhos vêm do pedido: escapa aspas, barras e caracteres de controlo
+static void json_string(json_t *j, const char *str) {
+    json_printf(j, "\"");
+    for (const unsigned char *p = (const unsigned char*)str; *p; p++) {
+        if (*p == '"' || *p == '\\') json_printf(j, "\\%c", *p);
+        else if (*p < 0x20) json_printf(j, "\\u%04x", *p);
+        else json_printf(j, "%c", *p);
+    }
+    json_printf(j, "\"");
+}
+
+static void json_top(json_t *j, const char *name, const path_rate_t *top) {
+    json_printf(j, "\"%s\":[", name);
+    for (int k = 0; k < TOPN_PUBLISH && top[k].path[0]; k++) {
+        json_printf(j, "%s{\"path\":", k ? "," : "");
+        json_string(j, top[k].path);
+        json_printf(j, ",\"rate\":%.2f}", top[k].rate);
+    }
+    json_printf(j, "],");
+}
+
+static void json_latency(json_t *j, const char *name, const hist_t *h) {
+    json_printf(j, "\"%s\":{\"avg_ms\":%.3f,\"p50\":%lu,\"p90\":%lu,\"p99\":%lu,\"p999\":%lu,\"max\":%lu}", name,
+                h->count ? h->sum_us / 1000.0 / h->count : 0.0,
+                hist_percentile(h, 50), hist_percentile(h, 90), hist_percentile(h, 99),
+                hist_percentile(h, 99.9), h->max_us);
+}
+
+void dashboard_publish(ipc_handles_t *ipc) {
+    if (!ipc || !ipc->shared_data) return;
+    shared_data_t *shm = ipc->shared_data;
+    static char buf[STATS_JSON_MAX];
+    json_t j = { .buf = buf, .cap = sizeof(buf) };
+
+    server_stats_t s;
+    stats_published(ipc, &s); // O stats_tick deste segundo já percorreu os slots
+    cache_stats_t c;
+    stats_cache_totals(ipc, &c);
+    time_t now = time(NULL);
+
+    json_printf(&j, "{\"time\":%ld,\"uptime\":%ld,\"requests\":%lu,\"bytes\":%lu,\"active\":%u,",
+                (long)now, (long)(now - s.start_time), s.total_requests, s.bytes_transferred, s.active_connections);
+    json_printf(&j, "\"queue\":{\"depth\":%u,\"limit\":%u},",
+                __atomic_load_n(&shm->accept_queue, __ATOMIC_RELAXED),
+                __atomic_load_n(&shm->accept_backlog, __ATOMIC_RELAXED));
+    json_printf(&j, "\"status\":{\"200\":%lu,\"403\":%lu,\"404\":%lu,\"500\":%lu,\"503\":%lu},",
+                s.status_200, s.status_403, s.status_404, s.status_500, s.status_503);
+    json_printf(&j, "\"classes\":[%lu,%lu,%lu,%lu,%lu,%lu],", s.status_class[0], s.status_class[1],
+                s.status_class[2], s.status_class[3], s.status_class[4], s.status_class[5]);
+    static const int windows[RATE_WINDOW_COUNT] = RATE_WINDOWS;
+    json_printf(&j, "\"rates\":[");
+    for (int r = 0; r < RATE_WINDOW_COUNT; r++) {
+        rate_stats_t rt;
+        stats_rates(ipc, windows[r], &rt);
+        json_printf(&j, "%s{\"window\":%d,\"requests\":%.2f,\"bytes\":%.0f,\"classes\":[%.2f,%.2f,%.2f,%.2f,%.2f,%.2f],\"latency\":[",
+                    r ? "," : "", windows[r], rt.requests, rt.bytes, rt.status_class[0], rt.status_class[1],
+                    rt.status_class[2], rt.status_class[3], rt.status_class[4], rt.status_class[5]);
+        for (int b = 0; b < RATE_BUCKETS; b++) json_printf(&j, "%s%lu", b ? "," : "", rt.latency[b]);
+        json_printf(&j, "]}");
+    }
+    // Pedidos de cada um dos últimos STATS_WINDOW_SECONDS segundos, do mais antigo para o mais recente
+    static second_stats_t history[STATS_WINDOW_SECONDS];
+    int n = stats_history(ipc, history, STATS_WINDOW_SECONDS);
+    json_printf(&j, "],\"history\":[");
+    for (int k = n - 1; k >= 0; k--) json_printf(&j, "%s%lu", k < n - 1 ? "," : "", history[k].requests);
+    json_printf(&j, "],");
+    json_latency(&j, "latency", &s.latency);
+    json_printf(&j, ",\"window\":\"" STATS_WINDOW_LABEL "\",");
+    json_latency(&j, "latency_window", &s.latency_window);
+    json_printf(&j, ",");
+    json_latency(&j, "cpu", &s.cpu);
+    static const char *stage_names[] = STAGE_NAMES;
+    json_printf(&j, ",\"stages\":{");
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        json_printf(&j, "%s", i ? "," : "");
+        json_latency(&j, stage_names[i], &s.stages[i]);
+    }
+    json_printf(&j, "}");
+    json_printf(&j, ",\"allocs\":{\"per_request\":%.2f,\"bytes_per_request\":%.0f,\"max\":%lu}",
+                s.latency.count ? (double)s.request_allocs / s.latency.count : 0.0,
+                s.latency.count ? (double)s.request_alloc_bytes / s.latency.count : 0.0, s.request_allocs_max);
+    static const char *vhost_names[] = VHOST_NAMES;
+    json_printf(&j, ",\"tcp\":{");
+    for (int v = 0; v < VHOST_COUNT; v++) {
+        tcp_stats_t t;
+        stats_tcp(ipc, v, &t);
+        json_printf(&j, "%s\"%s\":{\"samples\":%lu,\"retransmits\":%lu,\"retransmitted\":%lu,\"unacked\":%lu,"
+                    "\"cwnd\":%.1f,\"rttvar_us\":%.0f,\"delivery_p50_kbs\":%lu,\"delivery_p99_kbs\":%lu,", v ? "," : "", vhost_names[v],
+                    t.samples, t.retransmits, t.retransmitted, t.unacked, t.samples ? (double)t.cwnd_sum / t.samples : 0.0,
+                    t.samples ? (double)t.rttvar_sum / t.samples : 0.0,
+                    hist_percentile(&t.delivery, 50), hist_percentile(&t.delivery, 99));
+        json_latency(&j, "rtt", &t.rtt);
+        json_printf(&j, "}");
+    }
+    json_printf(&j, "}");
+    json_printf(&j, ",\"cache\":{\"hits\":%lu,\"l1_hits\":%lu,\"misses\":%lu,\"entries\":%lu,\"bytes\":%lu,\"budget\":%lu,"
+                "\"evictions\":[%lu,%lu,%lu],\"rejects\":[%lu,%lu],\"fills\":%lu,\"fill_ms\":%.3f},",
+                c.hits, c.l1_hits, c.misses, c.entries, c.bytes_used, c.bytes_budget,
+                c.evictions_capacity, c.evictions_stale, c.evictions_resize,
+                c.admission_rejects, c.size_rejects, c.fills, c.fill_time_us / 1000.0);
+    path_rate_t top[TOPN_PUBLISH];
+    stats_top_paths(ipc, 0, top);
+    json_top(&j, "top_hits", top);
+    stats_top_paths(ipc, 1, top);
+    json_top(&j, "top_bytes", top);
+    size_t workers_start = j.len; // Para cortar as secções por worker se não couberem
+    json_printf(&j, "\"workers\":[");
+    for (int i = 0; i < shm->num_workers && i < MAX_WORKERS; i++) {
+        cache_stats_t w;
+        stats_worker_cache(ipc, i, &w);
+        proc_stats_t p;
+        stats_worker_proc(ipc, i, &p);
+        mem_stats_t m;
+        stats_worker_mem(ipc, i, &m);
+        json_printf(&j, "%s{\"entries\":%lu,\"bytes\":%lu,\"budget\":%lu,\"rss\":%lu,\"faults\":[%lu,%lu],"
+                    "\"switches\":[%lu,%lu],\"perf\":%d,\"cycles_req\":%.0f,\"ipc\":%.3f,\"misses_req\":%.1f,\"switches_req\":%.3f,"
+                    "\"mem\":{\"cache_data\":%lu,\"cache_meta\":%lu,\"cache_reserved\":%lu,\"conn\":%lu,\"log\":%lu,"
+                    "\"heap_in_use\":%lu,\"heap_free\":%lu,\"heap_mmap\":%lu}}",
+                    i ? "," : "", w.entries, w.bytes_used, w.bytes_budget, p.rss_bytes, p.minor_faults, p.major_faults,
+                    p.voluntary_switches, p.involuntary_switches, p.perf_enabled, p.cycles_per_request,
+                    p.instructions_per_cycle, p.cache_misses_per_request, p.switches_per_request,
+                    w.data_bytes, w.meta_bytes, w.reserved_bytes, m.conn_buffers, m.log_buffers,
+                    m.heap_in_use, m.heap_free, m.heap_mmap);
+    }
+    json_printf(&j, "]}");
+    if (j.len >= j.cap && workers_start < j.cap) {
+        // Sem isto o JSON antigo ficava publicado para sempre e os clientes paravam
+        static int warned = 0;
+        if (!warned) {
+            fprintf(stderr, "[MASTER] /stats.json exceeds %d bytes, per-worker sections dropped\n", STATS_JSON_MAX);
+            warned = 1;
+        }
+        j.len = workers_start;
+        json_printf(&j, "\"workers\":[],\"truncated\":true}");
+    }
+    if (j.len >= j.cap) return; // Nem a parte fixa cabe: mantém o anterior
+
+    seq_write_begin(&shm->json_seq);
+    memcpy(shm->stats_json, buf, j.len);
+    shm->json_len = j.len;
+    seq_write_end(&shm->json_seq);
+}
+
+size_t dashboard_json(ipc_handles_t *ipc, char *buf, size_t cap) {
+    if (!ipc || !ipc->shared_data || cap == 0) return 0;
+    shared_data_t *shm = ipc->shared_data;
+    // Copia o comprimento e o texto dentro da mesma leitura do seqlock
+    for (int tries = 0; tries < SEQ_MAX_RETRIES; tries++) {
+        uint32_t before = __atomic_load_n(&shm->json_seq, __ATOMIC_ACQUIRE);
+        size_t len = shm->json_len;
+        if (len > cap) len = cap;
+        if (len > STATS_JSON_MAX) len = STATS_JSON_MAX;
+        memcpy(buf, shm->stats_json, len);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (!(before & 1) && __atomic_load_n(&shm->json_seq, __ATOMIC_RELAXED) == before) return len;
+    }
+    return 0;
+}
+
+// Stream SSE: uma thread por worker serve todos os clientes
+static ipc_handles_t *g_stream_ipc = NULL;
+static int *g_clients = NULL;
+static int g_max_clients = 0;
+static int g_num_clients = 0;
+static pthread_mutex_t g_clients_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t g_stream_thread;
+static int g_stream_started = 0;
+static volatile int g_stream_stop = 0;
+
+static void *stream_thread_fn(void *arg) {
+    (void)arg;
+    static char json[STATS_JSON_MAX];
+    static char event[STATS_JSON_MAX + 16];
+    uint32_t last_seq = __atomic_load_n(&g_stream_ipc->shared_data->json_seq, __ATOMIC_ACQUIRE);
+
+    while (!g_stream_stop) {
+        struct timespec ts = { 0, STREAM_POLL_MS * 1000000L };
+        nanosleep(&ts, NULL);
+
+        uint32_t seq = __atomic_load_n(&g_stream_ipc->shared_data->json_seq, __ATOMIC_ACQUIRE);
+        if (seq == last_seq || (seq & 1)) continue;
+        last_seq = seq; // Clientes novos já receberam a versão atual no pedido
+        pthread_mutex_lock(&g_clients_lock);
+        int idle = (g_num_clients == 0);
+        pthread_mutex_unlock(&g_clients_lock);
+        if (idle) continue;
+
+        size_t len = dashboard_json(g_stream_ipc, json, sizeof(json));
+        if (len == 0) continue;
+        int n = snprintf(event, sizeof(event), "data: %.*s\n\n", (int)len, json);
+        if (n >= (int)sizeof(event)) continue;
+
+        // Envio sem bloquear: um cliente lento (buffer cheio) ou fechado é descartado
+        pthread_mutex_lock(&g_clients_lock);
+        for (int i = 0; i < g_num_clients; ) {
+            ssize_t sent = send(g_clients[i], event, n, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (sent == n) {
+                i++;
+                continue;
+            }
+            close(g_clients[i]);
+            g_clients[i] = g_clients[--g_num_clients];
+        }
+        pthread_mutex_unlock(&g_clients_lock);
+    }
+    return NULL;
+}
+
+int dashboard_stream_init(ipc_handles_t *ipc, int max_clients) {
+    if (!ipc || !ipc->shared_data || max_clients <= 0) return 0;
+    g_clients = calloc(max_clients, sizeof(int));
+    if (!g_clients) return -1;
+    g_stream_ipc = ipc;
+    g_max_clients = max_clients;
+    g_stream_stop = 0;
+    if (pthread_create(&g_stream_thread, NULL, stream_thread_fn, NULL) != 0) {
+        free(g_clients);
+        g_clients = NULL;
+        g_max_clients = 0;
+        return -1;
+    }
+    g_stream_started = 1;
+    return 0;
+}
+
+int dashboard_stream_add(int client_fd) {
+    int ok = -1;
+    pthread_mutex_lock(&g_clients_lock);
+    if (g_stream_started && g_num_clients < g_max_clients) {
+        g_clients[g_num_clients++] = client_fd;
+        ok = 0;
+    }
+    pthread_mutex_unlock(&g_clients_lock);
+    return ok;
+}
+
+size_t dashboard_stream_buffer_bytes(void) {
+    if (!g_stream_started) return 0;
+    return 2 * STATS_JSON_MAX + 16 + (size_t)g_max_clients * sizeof(int);
+}
+
+void dashboard_stream_cleanup(void) {
+    if (g_stream_started) {
+        g_stream_stop = 1;
+        pthread_join(g_stream_thread, NULL);
+        g_stream_started = 0;
+    }
+    pthread_mutex_lock(&g_clients_lock);
+    for (int i = 0; i < g_num_clients; i++) close(g_clients[i]);
+    g_num_clients = 0;
+    free(g_clients);
+    g_clients = NULL;
+    g_max_clients = 0;
+    pthread_mutex_unlock(&g_clients_lock);
+}
@@ -0,0 +1,34 @@
+#ifndef DASHBOARD_H
+#define DASHBOARD_H
+
+#include <stddef.h>
+#include "master.h"
+
+// Dashboard em tempo real:
+//  - /stats: página estática (HTML + JS), igual para todos, guardada em cache pelo browser
+//  - /stats.json: fotografia compacta gerada pelo master 1x por segundo para a memória partilhada
+//  - /stats/stream: Server-Sent Events; uma thread por worker envia a fotografia nova a todos os clientes
+// Assim o custo de gerar os dados não depende do número de ecrãs abertos.
+
+// Master, 1x por segundo: renderiza o JSON para a memória partilhada
+void dashboard_publish(ipc_handles_t *ipc);
+
+// Página estática e a respetiva ETag (entre aspas, pronta para o cabeçalho)
+const char* dashboard_page(size_t *len, const char **etag);
+
+// Copia o último JSON publicado para buf. Devolve o tamanho (0 se ainda não houver)
+size_t dashboard_json(ipc_handles_t *ipc, char *buf, size_t cap);
+
+// Stream por worker (depois do fork). max_clients = 0 desliga.
+int dashboard_stream_init(ipc_handles_t *ipc, int max_clients);
+
+// Passa a conexão (já com os cabeçalhos SSE enviados) para a thread do stream.
+// Devolve 0 se ficou com ela; -1 se não há lugar (o chamador fecha o socket).
+int dashboard_stream_add(int client_fd);
+
+// Buffers da thread do stream e lista de clientes (0 se desligado)
+size_t dashboard_stream_buffer_bytes(void);
+
+void dashboard_stream_cleanup(void);
+
+#endif
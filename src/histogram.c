@@ -0,0 +1,64 @@
+#include "histogram.h"
+#include <string.h>
+
+static inline int bucket_index(uint64_t v) {
+    if (v < 2 * HIST_SUB) return (int)v;
+    if (v >> HIST_MAX_BITS) return HIST_BUCKETS - 1;
+    int e = 63 - __builtin_clzll(v) - HIST_SUB_BITS; // v >> e fica em [HIST_SUB, 2 * HIST_SUB)
+    return e * HIST_SUB + (int)(v >> e);
+}
+
+// Maior valor que cai no bucket
+static inline uint64_t bucket_value(int i) {
+    if (i < 2 * HIST_SUB) return (uint64_t)i;
+    int e = i / HIST_SUB - 1;
+    uint64_t m = (uint64_t)(i - e * HIST_SUB);
+    return ((m + 1) << e) - 1;
+}
+
+void hist_record(hist_t *h, uint64_t us) {
+    h->buckets[bucket_index(us)]++;
+    h->count++;
+    h->sum_us += us;
+    if (us > h->max_us) h->max_us = us;
+}
+
+void hist_merge(hist_t *dst, const hist_t *src) {
+    for (int i = 0; i < HIST_BUCKETS; i++) dst->buckets[i] += src->buckets[i];
+    dst->count += src->count;
+    dst->sum_us += src->sum_us;
+    if (src->max_us > dst->max_us) dst->max_us = src->max_us;
+}
+
+void hist_diff(hist_t *dst, const hist_t *a, const hist_t *b) {
+    memset(dst, 0, sizeof(*dst));
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        dst->buckets[i] = a->buckets[i] - b->buckets[i];
+        if (dst->buckets[i]) dst->max_us = bucket_value(i);
+    }
+    dst->count = a->count - b->count;
+    dst->sum_us = a->sum_us - b->sum_us;
+    if (dst->max_us > a->max_us) dst->max_us = a->max_us;
+}
+
+uint64_t hist_percentile(const hist_t *h, double p) {
+    if (h->count == 0) return 0;
+    uint64_t rank = (uint64_t)(p / 100.0 * h->count + 0.5);
+    if (rank < 1) rank = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            uint64_t v = bucket_value(i);
+            return v < h->max_us ? v : h->max_us;
+        }
+    }
+    return h->max_us;
+}
+
+uint64_t hist_count_le(const hist_t *h, uint64_t us) {
+    uint64_t n = 0;
+    for (int i = 0; i < HIST_BUCKETS && bucket_value(i) <= us; i++) n += h->buckets[i];
+    return n;
+}
@@ -0,0 +1,35 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+// Histograma log-linear (estilo HDR) de durações em microssegundos.
+// Abaixo de 32 us cada valor tem o seu bucket; acima, cada potência de 2 é dividida em
+// 16 buckets lineares (erro relativo < 6.25%). Valores acima de ~71 minutos ficam no último.
+#define HIST_SUB_BITS 4
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS 32
+#define HIST_BUCKETS ((HIST_MAX_BITS - HIST_SUB_BITS) * HIST_SUB + HIST_SUB)
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum_us;
+    uint64_t max_us;
+    uint64_t buckets[HIST_BUCKETS];
+} hist_t;
+
+void hist_record(hist_t *h, uint64_t us);
+
+// dst += src (histogramas de threads/workers diferentes somam-se bucket a bucket)
+void hist_merge(hist_t *dst, const hist_t *src);
+
+// dst = a - b (janela entre duas fotografias cumulativas; max fica aproximado pelo bucket)
+void hist_diff(hist_t *dst, const hist_t *a, const hist_t *b);
+
+// Valor no percentil p (0-100), em us
+uint64_t hist_percentile(const hist_t *h, double p);
+
+// Amostras em buckets que acabam em "us" ou antes (contagem cumulativa para exportar "le")
+uint64_t hist_count_le(const hist_t *h, uint64_t us);
+
+#endif
@@ -3,15 +3,33 @@
 #include "logger.h"
 #include "master.h"
 #include "cache.h"
+#include "preload.h"
+#include "negcache.h"
+#include "metrics.h"
+#include "dashboard.h"
+#include "topn.h"
+#include "trace.h"
+#include "probes.h"
+#include "tcpinfo.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <time.h>
 #include <ctype.h>
+#include <errno.h>
+
+#define REQUEST_BUFFER_SIZE 4096  // Leitura do pedido (uma só)
+#define HEADER_VALUE_MAX 1024     // Valor devolvido por get_header
+#define RESPONSE_HEADER_MAX 1024
+#define DISK_CHUNK_SIZE 65536     // Ficheiros fora da cache, lidos em blocos
+
+// Leituras de ficheiros para a memória em curso neste worker (contabilidade de memória)
+static size_t g_inflight_bytes = 0;
 
 const char* get_mime_type(const char* path) {
     // Hardcoded é mais rápido e simples que hash tables para isto
@@ -43,7 +61,7 @@ static inline ssize_t send_all(int sock, const char* buf, size_t len) {
 
 char* get_header(const char* buffer, const char* header_name) {
     // Cada thread tem seu buffer estático (evita locks e mallocs)
-    static __thread char value[1024]; 
+    static __thread char value[HEADER_VALUE_MAX];
     char* line = strstr(buffer, header_name);
     if (!line) return NULL;
 
@@ -51,7 +69,7 @@ char* get_header(const char* buffer, const char* header_name) {
     while (*line == ':' || *line == ' ') line++;
 
     int i = 0;
-    while (*line != '\r' && *line != '\n' && i < 1023) {
+    while (*line != '\r' && *line != '\n' && i < HEADER_VALUE_MAX - 1) {
         value[i++] = *line++;
     }
     value[i] = '\0';
@@ -86,9 +104,15 @@ void serve_custom_error(int client_fd, int code, const char* doc_root, ipc_handl
     char error_path[1024];
     snprintf(error_path, sizeof(error_path), "%s/errors/%d.html", doc_root, code);
     
+    // 404 da DOCUMENT_ROOT principal já vem pronto da memória
+    size_t prebuilt_len = 0;
+    const char* prebuilt = (code == 404) ? negcache_404_response(doc_root, &prebuilt_len) : NULL;
+
     // Tenta ficheiro HTML personalizado, senão usa texto simples
-    FILE* f = fopen(error_path, "rb");
-    if (f) {
+    FILE* f = prebuilt ? NULL : fopen(error_path, "rb");
+    if (prebuilt) {
+        send_all(client_fd, prebuilt, prebuilt_len);
+    } else if (f) {
         fseek(f, 0, SEEK_END);
         long size = ftell(f);
         fseek(f, 0, SEEK_SET);
@@ -119,223 +143,487 @@ void serve_custom_error(int client_fd, int code, const char* doc_root, ipc_handl
         send_all(client_fd, msg, len);
     }
     
-    // Stats atômicas
-    __sync_fetch_and_add(&ipc->shared_data->stats.total_requests, 1);
-    if (code == 404) __sync_fetch_and_add(&ipc->shared_data->stats.status_404, 1);
-    else if (code == 500) __sync_fetch_and_add(&ipc->shared_data->stats.status_500, 1);
-    else if (code == 403) __sync_fetch_and_add(&ipc->shared_data->stats.status_403, 1);
-    else if (code == 503) __sync_fetch_and_add(&ipc->shared_data->stats.status_503, 1);
+    // Stats no slot da thread
+    stats_update(ipc, code, 0);
 }
 
-void serve_dashboard(int client_fd, ipc_handles_t* ipc) {
-    // Copia local para não bloquear leitura enquanto gera o HTML
-    server_stats_t s;
-    memcpy(&s, &ipc->shared_data->stats, sizeof(server_stats_t));
-    
-    time_t now = time(NULL);
-    time_t uptime = now - s.start_time;
-    double avg_time = (s.total_requests > 0) ? 
-        (double)s.total_response_time_ms / s.total_requests : 0.0;
-
-    char body[8192];
-    int body_len = snprintf(body, sizeof(body),
-        "<!DOCTYPE html><html><head><title>Monitor Completo</title>"
-        "<meta charset='UTF-8'>"
-        "<meta http-equiv='refresh' content='2'>"
-        "<style>"
-        "body{font-family:'Segoe UI',sans-serif;padding:20px;background:#f0f2f5;color:#333;}"
-        ".grid{display:grid;grid-template-columns:repeat(auto-fit,minmax(300px,1fr));gap:20px;}"
-        ".card{background:white;padding:20px;border-radius:10px;box-shadow:0 2px 8px rgba(0,0,0,0.1);}"
-        "h1{text-align:center;color:#1a73e8;margin-bottom:30px;}"
-        "h2{font-size:1.1em;color:#5f6368;border-bottom:1px solid #eee;padding-bottom:10px;margin-top:0;}"
-        ".row{display:flex;justify-content:space-between;margin:8px 0;font-size:1.05em;}"
-        ".val{font-weight:bold;color:#1a73e8;}"
-        ".err{color:#d93025;} .ok{color:#188038;} .warn{color:#f57f17;}"
-        "</style></head>"
-        "<body>"
-        "<h1>Dashboard do Servidor</h1>"
-        "<div class='grid'>"
-        "<div class='card'><h2>Performance</h2>"
-        "<div class='row'><span>Uptime:</span> <span class='val'>%ld s</span></div>"
-        "<div class='row'><span>Conexões Ativas:</span> <span class='val'>%d</span></div>"
-        "<div class='row'><span>Tempo Médio:</span> <span class='val'>%.2f ms</span></div>"
-        "</div>"
-        "<div class='card'><h2>Tráfego</h2>"
-        "<div class='row'><span>Total Pedidos:</span> <span class='val'>%lu</span></div>"
-        "<div class='row'><span>Dados Enviados:</span> <span class='val'>%.2f MB</span></div>"
-        "</div>"
-        "<div class='card'><h2>Códigos de Resposta</h2>"
-        "<div class='row'><span>200 OK:</span> <span class='val ok'>%u</span></div>"
-        "<div class='row'><span>403 Forbidden:</span> <span class='val warn'>%u</span></div>"
-        "<div class='row'><span>404 Not Found:</span> <span class='val warn'>%u</span></div>"
-        "<div class='row'><span>500 Error:</span> <span class='val err'>%u</span></div>"
-        "<div class='row'><span>503 Busy:</span> <span class='val err'>%u</span></div>"
-        "</div>"
-        "</div></body></html>",
-        uptime, s.active_connections, avg_time,
-        s.total_requests, (double)s.bytes_transferred / (1024*1024),
-        s.status_200, s.status_403, s.status_404, s.status_500, s.status_503);
+// Página do dashboard: estática, o browser guarda-a e revalida com If-None-Match
+void serve_dashboard(int client_fd, const char* if_none_match) {
+    size_t body_len;
+    const char* etag;
+    const char* body = dashboard_page(&body_len, &etag);
 
     char header[512];
+    if (if_none_match && strcmp(if_none_match, etag) == 0) {
+        int hlen = snprintf(header, sizeof(header),
+            "HTTP/1.1 304 Not Modified\r\n"
+            "ETag: %s\r\n"
+            "Cache-Control: public, max-age=300\r\n"
+            "Connection: close\r\n\r\n", etag);
+        send_all(client_fd, header, hlen);
+        return;
+    }
+
     int hlen = snprintf(header, sizeof(header),
         "HTTP/1.1 200 OK\r\n"
         "Content-Type: text/html; charset=utf-8\r\n"
-        "Content-Length: %d\r\n"
+        "Content-Length: %zu\r\n"
+        "ETag: %s\r\n"
+        "Cache-Control: public, max-age=300\r\n"
+        "Connection: close\r\n\r\n", body_len, etag);
+
+    send_all(client_fd, header, hlen);
+    send_all(client_fd, body, body_len);
+}
+
+// JSON gerado pelo master: aqui só se copia da memória partilhada
+void serve_stats_json(int client_fd, ipc_handles_t* ipc) {
+    char body[STATS_JSON_MAX];
+    size_t body_len = dashboard_json(ipc, body, sizeof(body));
+    if (body_len == 0) {
+        body_len = 2;
+        memcpy(body, "{}", 2); // Antes do primeiro segundo
+    }
+
+    char header[256];
+    int hlen = snprintf(header, sizeof(header),
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: application/json\r\n"
+        "Content-Length: %zu\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Connection: close\r\n\r\n", body_len);
+
+    send_all(client_fd, header, hlen);
+    send_all(client_fd, body, body_len);
+}
+
+// Devolve 1 se a conexão passou para a thread do stream (não fechar)
+int serve_stats_stream(int client_fd, ipc_handles_t* ipc) {
+    static const char header[] =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/event-stream\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Connection: keep-alive\r\n\r\n";
+    if (send_all(client_fd, header, sizeof(header) - 1) < 0) return 0;
+
+    // Primeiro evento já com os dados atuais; os seguintes vêm da thread do stream
+    char json[STATS_JSON_MAX];
+    size_t len = dashboard_json(ipc, json, sizeof(json));
+    if (len > 0) {
+        send_all(client_fd, "data: ", 6);
+        send_all(client_fd, json, len);
+        send_all(client_fd, "\n\n", 2);
+    }
+    return dashboard_stream_add(client_fd) == 0;
+}
+
+void serve_metrics(int client_fd, const char* doc_root, ipc_handles_t* ipc) {
+    size_t body_len = 0;
+    char* body = metrics_render(ipc, &body_len);
+    if (!body) {
+        serve_custom_error(client_fd, 500, doc_root, ipc);
+        return;
+    }
+
+    char header[256];
+    int hlen = snprintf(header, sizeof(header),
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+        "Content-Length: %zu\r\n"
+        "Connection: close\r\n\r\n", body_len);
+
+    send_all(client_fd, header, hlen);
+    send_all(client_fd, body, body_len);
+    free(body);
+}
+
+// Ficheiros a ser lidos para memória: contam no relatório de memória do worker
+static void* inflight_alloc(size_t size) {
+    void* p = malloc(size);
+    if (p) __atomic_add_fetch(&g_inflight_bytes, size, __ATOMIC_RELAXED);
+    return p;
+}
+
+static void inflight_free(void* p, size_t size) {
+    __atomic_sub_fetch(&g_inflight_bytes, size, __ATOMIC_RELAXED);
+    free(p);
+}
+
+size_t http_buffer_bytes(int threads) {
+    size_t per_thread = REQUEST_BUFFER_SIZE + HEADER_VALUE_MAX + RESPONSE_HEADER_MAX + DISK_CHUNK_SIZE;
+    return (size_t)threads * per_thread + __atomic_load_n(&g_inflight_bytes, __ATOMIC_RELAXED);
+}
+
+// Envia [start, start+len) de um ficheiro grande a partir de segmentos em cache.
+// Os segmentos em falta são lidos do disco (pread alinhado) e guardados na cache.
+static void send_segments(int client_fd, const char* path, int fd, cache_t* cache, uint64_t tag, long start, long len) {
+    size_t seg_size = cache_segment_size(cache);
+    int own_fd = -1; // Só aberto aqui se quem chamou não tinha o ficheiro aberto
+    char* buf = NULL;
+    long pos = start, end = start + len;
+
+    while (pos < end) {
+        long idx = pos / seg_size;
+        size_t offset = pos - (size_t)idx * seg_size;
+        const char* data;
+        size_t seg_len;
+
+        cache_fill_t* fill = NULL;
+        cache_entry_t* seg = cache_acquire_segment(cache, path, idx, tag, &fill);
+        if (seg) {
+            data = cache_entry_get_data(seg);
+            seg_len = cache_entry_get_size(seg);
+        } else {
+            ssize_t n = -1;
+            if (fd < 0) fd = own_fd = open(path, O_RDONLY);
+            if (fd >= 0 && (buf || (buf = inflight_alloc(seg_size)))) {
+                n = pread(fd, buf, seg_size, (off_t)idx * seg_size);
+            }
+            if (n <= 0) {
+                cache_fill_abort(cache, fill);
+                break;
+            }
+            if (fill) seg = cache_fill_complete(cache, fill, buf, n);
+            else cache_put_segment(cache, path, idx, tag, buf, n);
+            data = buf;
+            seg_len = n;
+        }
+
+        // O ficheiro encolheu entretanto
+        if (offset >= seg_len) {
+            cache_release(seg);
+            break;
+        }
+
+        size_t chunk = seg_len - offset;
+        if ((long)chunk > end - pos) chunk = end - pos;
+        ssize_t sent = send_all(client_fd, data + offset, chunk);
+        cache_release(seg);
+        if (sent < 0) break;
+        pos += chunk;
+    }
+
+    if (own_fd >= 0) close(own_fd);
+    if (buf) inflight_free(buf, seg_size);
+}
+
+// Últimos pedidos lentos de todos os workers (texto, mais recentes primeiro)
+void serve_debug_slow(int client_fd, const char* doc_root, ipc_handles_t* ipc) {
+    int max = MAX_WORKERS * SLOW_RING_SIZE;
+    slow_entry_t* entries = malloc(max * sizeof(slow_entry_t));
+    char* body = malloc((size_t)max * 512 + 256);
+    if (!entries || !body) {
+        free(entries);
+        free(body);
+        serve_custom_error(client_fd, 500, doc_root, ipc);
+        return;
+    }
+
+    int n = stats_slow_requests(ipc, entries, max);
+    size_t body_len = snprintf(body, 256, "# %d slow requests (>= %u ms), newest first, stages in ms\n",
+                               n, ipc->shared_data->slow_us / 1000);
+    for (int i = 0; i < n; i++) {
+        int len = stats_format_slow(&entries[i], body + body_len, 511);
+        if (len > 510) len = 510; // Linha truncada
+        body_len += len;
+        body[body_len++] = '\n';
+    }
+
+    char header[256];
+    int hlen = snprintf(header, sizeof(header),
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/plain; charset=utf-8\r\n"
+        "Content-Length: %zu\r\n"
+        "Cache-Control: no-cache\r\n"
         "Connection: close\r\n\r\n", body_len);
 
     send_all(client_fd, header, hlen);
     send_all(client_fd, body, body_len);
+    free(entries);
+    free(body);
+}
+
+// Versão do ficheiro (mtime + tamanho) que identifica os seus segmentos
+static uint64_t file_tag(const struct stat* st) {
+    return ((uint64_t)st->st_mtim.tv_sec * 1000000000ULL + st->st_mtim.tv_nsec) ^ (uint64_t)st->st_size;
+}
+
+// Lê o ficheiro inteiro (só os que cabem na cache)
+static int read_file(int fd, void* buf, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(fd, (char*)buf + done, size - done, (off_t)done);
+        if (n <= 0) return -1;
+        done += n;
+    }
+    return 0;
 }
 
-void serve_file(int client_fd, const char* path, const char* doc_root, ipc_handles_t* ipc, const char* range_header, cache_t* cache) {
-    struct timespec start;
-    clock_gettime(CLOCK_MONOTONIC, &start);
+// Cabeçalho Range com um só intervalo: "bytes=a-b", "bytes=a-" ou "bytes=-sufixo".
+// Devolve 1 com [start, end] dentro do ficheiro, 0 se deve ser ignorado (resposta 200
+// completa) e -1 se nenhum dos bytes pedidos existe (416).
+static int parse_range(const char* header, size_t filesize, long* start, long* end) {
+    if (strncmp(header, "bytes=", 6) != 0 || strchr(header, ',')) return 0;
+    const char* p = header + 6;
+    char* after;
+
+    if (*p == '-') {
+        // Últimos N bytes
+        if (!isdigit((unsigned char)p[1])) return 0;
+        long suffix = strtol(p + 1, &after, 10);
+        if (*after != '\0' || suffix < 0) return 0;
+        if (suffix == 0 || filesize == 0) return -1;
+        *start = (size_t)suffix >= filesize ? 0 : (long)filesize - suffix;
+        *end = (long)filesize - 1;
+        return 1;
+    }
+
+    if (!isdigit((unsigned char)*p)) return 0;
+    long first = strtol(p, &after, 10);
+    if (*after != '-' || first < 0) return 0;
+    p = after + 1;
+    long last = (long)filesize - 1;
+    if (*p) {
+        if (!isdigit((unsigned char)*p)) return 0;
+        last = strtol(p, &after, 10);
+        if (*after != '\0' || last < first) return 0;
+    }
+    if ((size_t)first >= filesize) return -1;
+    if ((size_t)last >= filesize) last = (long)filesize - 1;
+    *start = first;
+    *end = last;
+    return 1;
+}
 
-    // Tenta Cache
-    cache_entry_t* cached = cache_get(cache, path);
+// Acima de CACHE_MAX_OBJECT_KB o ficheiro nunca é guardado inteiro (só consultado num miss)
+static int too_large_for_cache(const char* path, cache_t* cache) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode) && (size_t)st.st_size > cache_max_object_size(cache);
+}
+
+// Devolve os bytes do corpo enviados (0 nas respostas de erro)
+long serve_file(int client_fd, const char* path, const char* doc_root, ipc_handles_t* ipc, const char* range_header, cache_t* cache, request_timing_t* timing) {
+    const void* preloaded = NULL;
+    cache_entry_t* cached = NULL;
+    cache_fill_t* fill = NULL;
     void* file_data = NULL;
+    void* owned_data = NULL; // Buffer lido do disco (a cache guarda a sua própria cópia)
     size_t filesize = 0;
     int from_cache = 0;
-
-    if (cached) {
+    int segmented = 0;     // Range num ficheiro acima de CACHE_MAX_OBJECT_KB: segmentos em cache
+    int fd = -1;           // O ficheiro é aberto no máximo uma vez por pedido
+    uint64_t tag = 0;      // Versão do ficheiro para os segmentos
+    struct stat st;
+
+    // Tenta o pré-carregamento partilhado (só leitura), depois a cache do worker
+    if (preload_lookup(path, &preloaded, &filesize)) {
+        file_data = (void*)preloaded;
+        from_cache = 1;
+    } else if (negcache_is_missing(path)) {
+        // Caminho que sabemos não existir: 404 sem tocar no disco nem nos locks da cache
+        // (os scanners não contam no sketch nem criam fills)
+        timing_mark(timing, STAGE_CACHE);
+        if (timing) timing->status = 404;
+        serve_custom_error(client_fd, 404, doc_root, ipc);
+        return 0;
+    } else if (range_header && cache_segment_size(cache) > 0 && stat(path, &st) == 0 && S_ISREG(st.st_mode) &&
+               (size_t)st.st_size > cache_max_object_size(cache)) {
+        // Seek num ficheiro grande: vai direto aos segmentos, sem procurar o ficheiro inteiro
+        filesize = st.st_size;
+        tag = file_tag(&st);
+        segmented = 1;
+    } else if ((cached = cache_find(cache, path)) != NULL ||
+               (!too_large_for_cache(path, cache) && (cached = cache_acquire(cache, path, &fill)) != NULL)) {
+        // Hit, ou outra thread acabou de carregar o mesmo ficheiro. Um ficheiro grande nunca
+        // passa pelo cache_acquire: não conta um miss nem cria um fill que seria abortado.
         file_data = cache_entry_get_data(cached);
         filesize = cache_entry_get_size(cached);
         from_cache = 1;
     } else {
-        // Se falhar, Disco
-        FILE* f = fopen(path, "rb");
-        if (!f) {
-            serve_custom_error(client_fd, 404, doc_root, ipc);
-            return;
+        timing_mark(timing, STAGE_CACHE);
+        // Se falhar, Disco (se "fill" estiver preenchido, somos nós a carregar para os outros)
+        fd = open(path, O_RDONLY);
+        PROBE_FILE_OPEN(path, fd >= 0 ? 0 : errno);
+        int err = errno;
+        if (fd >= 0 && (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))) {
+            close(fd);
+            fd = -1;
+            err = EISDIR;
         }
-
-        fseek(f, 0, SEEK_END);
-        filesize = ftell(f);
-        fseek(f, 0, SEEK_SET);
-
-        // Só mete em cache ficheiros pequenos (<1MB)
-        if (filesize < 1024 * 1024) {
-            file_data = malloc(filesize);
-            if (file_data) {
-                fread(file_data, 1, filesize, f);
-                cache_put(cache, path, file_data, filesize);
-                from_cache = 1; 
-            }
+        if (fd < 0) {
+            timing_mark(timing, STAGE_DISK);
+            if (err == ENOENT) negcache_add(path);
+            cache_fill_abort(cache, fill);
+            if (timing) timing->status = 404;
+            serve_custom_error(client_fd, 404, doc_root, ipc);
+            return 0;
         }
-        fclose(f);
-
-        if (!from_cache) {
-            f = fopen(path, "rb");
-            if (!f) {
+        filesize = st.st_size;
+        tag = file_tag(&st);
+
+        if (filesize > cache_max_object_size(cache)) {
+            // Download completo: lido do disco em chunks, sem passar pela cache, para um ficheiro
+            // de vários GB não expulsar o working set. Só os seeks (Range) usam segmentos.
+            if (range_header && cache_segment_size(cache) > 0) segmented = 1;
+        } else if (cache_admits_size(cache, filesize) && (owned_data = inflight_alloc(filesize)) != NULL) {
+            // Só mete em cache ficheiros até CACHE_MAX_OBJECT_KB
+            if (read_file(fd, owned_data, filesize) != 0) {
+                inflight_free(owned_data, filesize);
+                cache_fill_abort(cache, fill);
+                close(fd);
+                if (timing) timing->status = 500;
                 serve_custom_error(client_fd, 500, doc_root, ipc);
-                return;
+                return 0;
             }
+            if (fill) cached = cache_fill_complete(cache, fill, owned_data, filesize);
+            else cache_put(cache, path, owned_data, filesize);
+            fill = NULL;
+            file_data = owned_data;
+            from_cache = 1;
         }
+        cache_fill_abort(cache, fill); // Não foi guardado (ficheiro grande ou sem memória)
     }
-
-    long start_byte = 0, end_byte = filesize - 1;
-    int is_partial = 0;
-
-    if (range_header && sscanf(range_header, "bytes=%ld-%ld", &start_byte, &end_byte) >= 1) {
-        if (end_byte >= (long)filesize || end_byte == 0) end_byte = filesize - 1;
-        is_partial = 1;
-    }
-
-    long content_len = end_byte - start_byte + 1;
-    char header[1024];
+    // Hit: só a procura; miss: o tempo desde a procura foi do disco
+    int hit = from_cache && !owned_data;
+    timing_mark(timing, hit ? STAGE_CACHE : STAGE_DISK);
+    if (timing) timing->cache_hit = hit;
+
+    long start_byte = 0, end_byte = (long)filesize - 1;
+    int range = range_header ? parse_range(range_header, filesize, &start_byte, &end_byte) : 0;
+    int is_partial = range > 0;
+    int status = range < 0 ? 416 : (is_partial ? 206 : 200);
+    if (timing) timing->status = status;
+
+    long content_len = range < 0 ? 0 : end_byte - start_byte + 1;
+    // Uma resposta por conexão: com keep-alive o cliente reutilizaria um socket que vamos fechar
+    char header[RESPONSE_HEADER_MAX];
     int hlen;
 
-    if (is_partial) {
+    if (range < 0) {
+        hlen = snprintf(header, sizeof(header),
+            "HTTP/1.1 416 Range Not Satisfiable\r\n"
+            "Content-Range: bytes */%zu\r\n"
+            "Content-Length: 0\r\n"
+            "Connection: close\r\n\r\n", filesize);
+    } else if (is_partial) {
         hlen = snprintf(header, sizeof(header),
             "HTTP/1.1 206 Partial Content\r\n"
             "Content-Type: %s\r\n"
             "Content-Range: bytes %ld-%ld/%zu\r\n"
             "Content-Length: %ld\r\n"
-            "Connection: keep-alive\r\n\r\n",
+            "Connection: close\r\n\r\n",
             get_mime_type(path), start_byte, end_byte, filesize, content_len);
     } else {
         hlen = snprintf(header, sizeof(header),
             "HTTP/1.1 200 OK\r\n"
             "Content-Type: %s\r\n"
             "Content-Length: %zu\r\n"
-            "Connection: keep-alive\r\n\r\n",
+            "Connection: close\r\n\r\n",
             get_mime_type(path), filesize);
     }
 
+    timing_mark(timing, STAGE_HEADER);
     send_all(client_fd, header, hlen);
 
     // Envio dos dados
-    if (from_cache) {
+    if (content_len <= 0) {
+        // 416 ou ficheiro vazio: só o cabeçalho
+    } else if (from_cache) {
         // Direto da RAM
         send_all(client_fd, (char*)file_data + start_byte, content_len);
-    } else {
+    } else if (segmented) {
+        // Ficheiro grande: segmentos em cache (ideal para seeks em vídeo)
+        send_segments(client_fd, path, fd, cache, tag, start_byte, content_len);
+    } else if (fd >= 0) {
         // Leitura do disco em chunks (64KB)
-        FILE* f = fopen(path, "rb");
-        if (f) {
-            fseek(f, start_byte, SEEK_SET);
-            char buf[65536]; 
-            long sent = 0;
-            while (sent < content_len) {
-                long to_read = (content_len - sent > (long)sizeof(buf)) ? 
-                    (long)sizeof(buf) : (content_len - sent);
-                size_t n = fread(buf, 1, to_read, f);
-                if (n <= 0) break;
-                send_all(client_fd, buf, n);
-                sent += n;
-            }
-            fclose(f);
+        char buf[DISK_CHUNK_SIZE];
+        long sent = 0;
+        while (sent < content_len) {
+            long to_read = (content_len - sent > (long)sizeof(buf)) ?
+                (long)sizeof(buf) : (content_len - sent);
+            ssize_t n = pread(fd, buf, to_read, (off_t)(start_byte + sent));
+            timing_mark(timing, STAGE_DISK);
+            if (n <= 0) break;
+            send_all(client_fd, buf, n);
+            timing_mark(timing, STAGE_SEND);
+            sent += n;
         }
     }
 
-    struct timespec end;
-    clock_gettime(CLOCK_MONOTONIC, &end);
-    long ms = (end.tv_sec - start.tv_sec) * 1000 + 
-              (end.tv_nsec - start.tv_nsec) / 1000000;
+    if (fd >= 0) close(fd);
+    if (cached) cache_release(cached);
+    if (owned_data) inflight_free(owned_data, filesize);
 
     // Atualiza stats
-    __sync_fetch_and_add(&ipc->shared_data->stats.total_requests, 1);
-    __sync_fetch_and_add(&ipc->shared_data->stats.bytes_transferred, content_len);
-    __sync_fetch_and_add(&ipc->shared_data->stats.status_200, 1);
-    __sync_fetch_and_add(&ipc->shared_data->stats.total_response_time_ms, ms);
+    stats_update(ipc, status, content_len);
+    return content_len;
 }
 
-void http_handle_request(int client_fd, const char *default_root, ipc_handles_t *ipc, cache_t* cache) {
+void http_handle_request(int client_fd, const char *default_root, ipc_handles_t *ipc, cache_t* cache,
+                         const struct timespec *accepted) {
+    // Latência medida desde que a thread pega na conexão até a resposta estar enviada
+    request_timing_t timing;
+    timing_start(&timing, client_fd, accepted);
+    timing.sampled = trace_sample();
+    if (timing.sampled) timing.queue_us = tcpinfo_queue_us(client_fd, &timing.accepted);
+
     // Timeout 2s
     struct timeval tv = {2, 0}; 
     setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
     
-    char buffer[4096];
+    char buffer[REQUEST_BUFFER_SIZE];
     
     // Leitura única para simplificar
     ssize_t n = recv(client_fd, buffer, sizeof(buffer)-1, 0);
     if (n <= 0) {
+        PROBE_CONN_CLOSE(client_fd, 0);
         close(client_fd);
         return;
     }
     buffer[n] = '\0';
+    timing_mark(&timing, STAGE_RECV);
 
     char *method = NULL, *path = NULL;
     if (parse_http_request(buffer, &method, &path) != 0) {
+        PROBE_CONN_CLOSE(client_fd, 0);
         close(client_fd);
         return;
     }
 
     // Virtual Hosts (site1 vs site2)
+    // get_header devolve sempre o mesmo buffer da thread: copia o Host antes de ler o Range
     char current_root[1024];
-    char* host = get_header(buffer, "Host");
+    char host[256];
+    const char* host_header = get_header(buffer, "Host");
+    snprintf(host, sizeof(host), "%s", host_header ? host_header : "");
     char* range = get_header(buffer, "Range");
 
-    if (host && strstr(host, "site1")) {
+    int vhost = VHOST_DEFAULT;
+    if (strstr(host, "site1")) {
         snprintf(current_root, sizeof(current_root), "./www/site1");
-    } else if (host && strstr(host, "site2")) {
+        vhost = VHOST_SITE1;
+    } else if (strstr(host, "site2")) {
         snprintf(current_root, sizeof(current_root), "./www/site2");
+        vhost = VHOST_SITE2;
     } else {
         strcpy(current_root, default_root);
     }
+    timing_mark(&timing, STAGE_PARSE);
+    timing.path = path;
+    timing.vhost = host;
+    PROBE_REQUEST_PARSED(client_fd, method, path, host);
 
+    int keep_open = 0;
     if (strcmp(path, "/stats") == 0) {
-        serve_dashboard(client_fd, ipc);
-        log_request(ipc, "127.0.0.1", "/stats", method, 200, 0);
+        serve_dashboard(client_fd, get_header(buffer, "If-None-Match"));
+    } else if (strcmp(path, "/stats.json") == 0) {
+        serve_stats_json(client_fd, ipc);
+    } else if (strcmp(path, "/stats/stream") == 0) {
+        keep_open = serve_stats_stream(client_fd, ipc);
+    } else if (strcmp(path, "/metrics") == 0) {
+        serve_metrics(client_fd, current_root, ipc);
+    } else if (strcmp(path, "/debug/slow") == 0) {
+        serve_debug_slow(client_fd, current_root, ipc);
     } else {
         char full[2048];
         if (strcmp(path, "/") == 0) {
@@ -344,11 +632,23 @@ void http_handle_request(int client_fd, const char *default_root, ipc_handles_t
             snprintf(full, sizeof(full), "%s%s", current_root, path);
         }
 
-        serve_file(client_fd, full, current_root, ipc, range, cache);
-        log_request(ipc, "127.0.0.1", path, method, 200, 0);
+        long sent = serve_file(client_fd, full, current_root, ipc, range, cache, &timing);
+        topn_record(full, sent);
+        timing.bytes = sent;
     }
+    timing_mark(&timing, STAGE_SEND); // Resto da resposta (ou a resposta gerada inteira)
+    PROBE_RESPONSE_SENT(client_fd, timing.status, timing.bytes, timespec_diff_us(&timing.start, &timing.mark));
+
+    log_request(ipc, "127.0.0.1", path, method, 200, 0);
+    timing_mark(&timing, STAGE_LOG);
+    stats_record_request(ipc, &timing);
+    if (timing.sampled) trace_submit(&timing, method);
     
     free(method);
     free(path);
-    close(client_fd);
+    PROBE_CONN_CLOSE(client_fd, keep_open);
+    if (!keep_open) {
+        tcpinfo_sample(ipc, client_fd, vhost);
+        close(client_fd);
+    }
 }
\ No newline at end of file
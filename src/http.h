@@ -4,6 +4,11 @@
 #include "master.h"
 #include "cache.h"
 
-void http_handle_request(int client_fd, const char *document_root, ipc_handles_t *ipc, cache_t* cache);
+// accepted: CLOCK_MONOTONIC logo a seguir ao accept (intervalos "queue" e "accept" do trace)
+void http_handle_request(int client_fd, const char *document_root, ipc_handles_t *ipc, cache_t* cache,
+                         const struct timespec *accepted);
+
+// Buffers de "threads" threads de pedidos mais os ficheiros a ser lidos para memória neste momento
+size_t http_buffer_bytes(int threads);
 
 #endif
\ No newline at end of file
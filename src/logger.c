@@ -7,8 +7,11 @@
 #include <sys/stat.h>
 #include <stdlib.h>
 
+#define LOG_BUFFER_SIZE 4096
+
 // Ponteiro global para o ficheiro de log
 static FILE *g_log_file = NULL;
+static char g_log_buffer[LOG_BUFFER_SIZE]; // Buffer do stdio com tamanho conhecido (contabilidade de memória)
 
 int logger_init(const char *log_file) {
     if (!log_file) return -1;
@@ -19,10 +22,15 @@ int logger_init(const char *log_file) {
         perror("fopen (log file)");
         return -1;
     }
+    setvbuf(g_log_file, g_log_buffer, _IOFBF, sizeof(g_log_buffer));
     
     return 0;
 }
 
+size_t logger_buffer_bytes(void) {
+    return g_log_file ? sizeof(g_log_buffer) : 0;
+}
+
 void logger_cleanup(void) {
     if (g_log_file) {
         fclose(g_log_file);
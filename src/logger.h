@@ -13,4 +13,7 @@ int logger_init(const char *log_file);
 // Fecha o sistema de logging no shutdown
 void logger_cleanup(void);
 
+// Memória do buffer do ficheiro de log (0 se não estiver aberto)
+size_t logger_buffer_bytes(void);
+
 #endif
\ No newline at end of file
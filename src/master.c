@@ -2,6 +2,8 @@
 #include "master.h"
 #include "worker.h"
 #include "logger.h"
+#include "preload.h"
+#include "dashboard.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -20,9 +22,16 @@ static pid_t *g_worker_pids = NULL;
 static int g_num_workers = 0;
 static ipc_handles_t g_ipc_handles;
 static volatile sig_atomic_t g_running = 1;
+static volatile sig_atomic_t g_dump_slow = 0;
 
 static void cleanup_and_exit(void);
 
+// SIGUSR1: o loop do master imprime os pedidos lentos (fora do handler)
+static void dump_handler(int signum) {
+    (void)signum;
+    g_dump_slow = 1;
+}
+
 static void signal_handler(int signum) {
     (void)signum;
     printf("\n[MASTER] Shutdown signal received\n");
@@ -36,32 +45,31 @@ static void signal_handler(int signum) {
 }
 
 
-int ipc_init(ipc_handles_t *handles, int max_queue_size) {
+int ipc_init(ipc_handles_t *handles, int max_queue_size, int num_slots) {
     if (!handles) return -1;
     memset(handles, 0, sizeof(ipc_handles_t));
 
     // Configurar Memória Partilhada
     handles->shm_fd = shm_open(SHM_NAME, O_CREAT | O_RDWR, 0666);
     if (handles->shm_fd < 0) return -1;
-    if (ftruncate(handles->shm_fd, sizeof(shared_data_t)) < 0) return -1;
+    handles->shm_size = SHARED_DATA_SIZE(num_slots);
+    if (ftruncate(handles->shm_fd, handles->shm_size) < 0) return -1;
     // Mapear SHM para o espaço de endereços do processo
-    handles->shared_data = mmap(NULL, sizeof(shared_data_t), PROT_READ | PROT_WRITE, MAP_SHARED, handles->shm_fd, 0);
+    handles->shared_data = mmap(NULL, handles->shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, handles->shm_fd, 0);
     if (handles->shared_data == MAP_FAILED) return -1;
 
     // Inicializar a SHM com zeros e guardar o tamanho da fila
-    memset(handles->shared_data, 0, sizeof(shared_data_t));
+    memset(handles->shared_data, 0, handles->shm_size);
     handles->shared_data->queue.max_size = max_queue_size; 
-    handles->shared_data->stats.start_time = time(NULL); // Importante para o Dashboard
+    handles->shared_data->start_time = time(NULL); // Importante para o Dashboard
 
     // Configurar Semáforos
-    sem_unlink(SEM_STATS_NAME);
     sem_unlink(SEM_LOG_NAME);
     
     // Abre/Cria os semáforos. Inicializaos a1
-    handles->sem_stats = sem_open(SEM_STATS_NAME, O_CREAT, 0666, 1);
     handles->sem_log = sem_open(SEM_LOG_NAME, O_CREAT, 0666, 1);
 
-    if (handles->sem_stats == SEM_FAILED || handles->sem_log == SEM_FAILED) return -1;
+    if (handles->sem_log == SEM_FAILED) return -1;
     return 0;
 }
 
@@ -69,15 +77,18 @@ void ipc_cleanup(ipc_handles_t *handles) {
     if (!handles) return;
     // Fechar descritores e remove do sistema
     if (handles->sem_log) { sem_close(handles->sem_log); sem_unlink(SEM_LOG_NAME); }
-    if (handles->sem_stats) { sem_close(handles->sem_stats); sem_unlink(SEM_STATS_NAME); }
     // Desfazer mapeamento da memória
-    if (handles->shared_data) munmap(handles->shared_data, sizeof(shared_data_t));
+    if (handles->shared_data) munmap(handles->shared_data, handles->shm_size);
     // Fechar SHM
     if (handles->shm_fd >= 0) { close(handles->shm_fd); shm_unlink(SHM_NAME); }
 }
 
 int master_init(server_config_t *config) {
     if (!config) return -1;
+    if (config->num_workers > MAX_WORKERS) {
+        fprintf(stderr, "[MASTER] NUM_WORKERS limited to %d\n", MAX_WORKERS);
+        config->num_workers = MAX_WORKERS;
+    }
     g_num_workers = config->num_workers;
 
     // Configurar o tratamento de sinais SIGINT e SIGTERM
@@ -87,10 +98,17 @@ int master_init(server_config_t *config) {
     sa.sa_flags = 0;
     sigaction(SIGINT, &sa, NULL);
     sigaction(SIGTERM, &sa, NULL);
+    sa.sa_handler = dump_handler;
+    sigaction(SIGUSR1, &sa, NULL);
 
     // Inicialização dos subsistemas
     logger_init(config->log_file);
-    if (ipc_init(&g_ipc_handles, config->max_queue_size) != 0) return -1;
+    // Um slot de estatísticas por thread de cada worker
+    if (ipc_init(&g_ipc_handles, config->max_queue_size, g_num_workers * config->threads_per_worker) != 0) return -1;
+    g_ipc_handles.shared_data->num_workers = g_num_workers;
+    g_ipc_handles.shared_data->threads_per_worker = config->threads_per_worker;
+    g_ipc_handles.shared_data->slow_us = config->slow_request_ms > 0 ? (uint32_t)config->slow_request_ms * 1000 : 0;
+    g_ipc_handles.shared_data->tcp_sample_rate = config->tcp_info_sample_rate > 0 ? (uint32_t)config->tcp_info_sample_rate : 0;
 
     // Configurar Socket de Escuta
     g_listen_fd = socket(AF_INET, SOCK_STREAM, 0);
@@ -107,6 +125,12 @@ int master_init(server_config_t *config) {
 
     printf("[MASTER] Listening on port %d\n", config->port);
 
+    // Pré-carregamento partilhado: tem de acontecer antes do fork
+    if (preload_init(config) != 0) {
+        fprintf(stderr, "[MASTER] Preload failed, continuing without it\n");
+        preload_cleanup();
+    }
+
     // Lançar Workers (Multi-processo)
     g_worker_pids = calloc(g_num_workers, sizeof(pid_t));
     for (int i = 0; i < g_num_workers; ++i) {
@@ -124,10 +148,21 @@ int master_init(server_config_t *config) {
 void master_accept_loop(void) {
     printf("[MASTER] Monitorando (Workers a aceitar conexoes)...\n");
     time_t last_stats = time(NULL);
+    time_t last_tick = 0;
 
     while (g_running) {
-        sleep(1); // Evita busy-wait
+        sleep(1); // Evita busy-wait (um sinal acorda mais cedo)
         time_t now = time(NULL);
+        if (now != last_tick) {
+            stats_tick(&g_ipc_handles); // Janela deslizante dos percentis
+            stats_sample_queue(&g_ipc_handles, g_listen_fd);
+            dashboard_publish(&g_ipc_handles); // /stats.json: uma renderização por segundo para todos os clientes
+            last_tick = now;
+        }
+        if (g_dump_slow) {
+            g_dump_slow = 0;
+            stats_dump_slow(&g_ipc_handles);
+        }
         // Atualiza estatísticas a cada 10 segundos
         if (now - last_stats >= 10) {
             stats_display(&g_ipc_handles);
@@ -147,6 +182,7 @@ void master_cleanup(void) {
     // Limpa IPC (shm, semáforos) e logs
     ipc_cleanup(&g_ipc_handles);
     logger_cleanup();
+    preload_cleanup();
     free(g_worker_pids);
 }
 
@@ -14,7 +14,6 @@
 #define SEM_MUTEX_NAME "/concurrent_http_mutex" // Mutex para exclusão mútua na fila
 #define SEM_EMPTY_NAME "/concurrent_http_empty"
 #define SEM_FULL_NAME "/concurrent_http_full"
-#define SEM_STATS_NAME "/concurrent_http_stats"
 #define SEM_LOG_NAME "/concurrent_http_log"
 
 typedef struct {
@@ -31,23 +30,44 @@ typedef struct {
 
 typedef struct {
     connection_queue_t queue;
-    server_stats_t stats;
+    time_t start_time;
+    int num_workers;
+    int threads_per_worker;
+    worker_stats_t workers[MAX_WORKERS];
+    uint32_t window_seq;             // Seqlock da janela (escrita só pelo master)
+    hist_t latency_window;
+    uint32_t history_seq;            // Seqlock do anel por segundo (escrito só pelo master)
+    uint32_t history_pos;            // Posição do último segundo escrito
+    second_stats_t history[STATS_HISTORY_SECONDS];
+    uint32_t accept_queue;           // Conexões à espera de accept() (amostrado pelo master)
+    uint32_t accept_backlog;         // Limite da fila do listen()
+    uint32_t slow_us;                // SLOW_REQUEST_MS em us (0 = não regista)
+    uint32_t tcp_sample_rate;        // TCP_INFO_SAMPLE_RATE (0 = desligado)
+    uint32_t snapshot_seq;           // Seqlock da fotografia agregada (escrita só pelo master, 1x por segundo)
+    server_stats_t snapshot;
+    uint32_t json_seq;               // Seqlock do /stats.json (escrito só pelo master)
+    uint32_t json_len;
+    char stats_json[STATS_JSON_MAX];
+    stats_slot_t slots[];            // Slot da thread t do worker w: w * threads_per_worker + t
 } shared_data_t;
 
+// Tamanho da zona partilhada para "num_slots" threads
+#define SHARED_DATA_SIZE(num_slots) (sizeof(shared_data_t) + (size_t)(num_slots) * sizeof(stats_slot_t))
+
 
 typedef struct {
     /* Shared memory */
     shared_data_t *shared_data;
+    size_t shm_size;
     int shm_fd;                        
     sem_t *sem_mutex;
     sem_t *sem_empty;                  
     sem_t *sem_full;                   
-    sem_t *sem_stats;
     sem_t *sem_log;
 } ipc_handles_t;
 
 
-int ipc_init(ipc_handles_t *handles, int max_queue_size); // Inicialização do Semáforos 
+int ipc_init(ipc_handles_t *handles, int max_queue_size, int num_slots); // Inicialização do Semáforos 
 int ipc_attach(ipc_handles_t *handles);
 void ipc_cleanup(ipc_handles_t *handles);
 void ipc_detach(ipc_handles_t *handles);
@@ -55,11 +75,37 @@ void ipc_detach(ipc_handles_t *handles);
 int queue_enqueue(ipc_handles_t *handles, int client_fd);
 int queue_dequeue(ipc_handles_t *handles);
 
+// Cada thread de um worker reserva o seu slot antes de atender pedidos.
+// As funções de escrita abaixo não fazem nada numa thread sem slot.
+void stats_bind_thread(ipc_handles_t *handles, int worker_id);
 void stats_update(ipc_handles_t *handles, int status_code, uint64_t bytes);
 void stats_inc_active(ipc_handles_t *handles);
 void stats_dec_active(ipc_handles_t *handles);
+void stats_record_request(ipc_handles_t *handles, const request_timing_t *timing); // Duração total, etapas e CPU
+void stats_publish_cache(ipc_handles_t *handles, int worker_id, const cache_stats_t *cache);
+void stats_publish_top(ipc_handles_t *handles, int worker_id, const path_rate_t *hits, const path_rate_t *bytes);
+void stats_record_tcp(ipc_handles_t *handles, int vhost, const tcp_sample_t *sample); // Thread do pedido (amostras)
+void stats_publish_proc(ipc_handles_t *handles, int worker_id, const proc_stats_t *proc, const mem_stats_t *mem);
+uint64_t stats_worker_requests(ipc_handles_t *handles, int worker_id); // Pedidos servidos pelas threads do worker
+uint32_t stats_worker_active(ipc_handles_t *handles, int worker_id);   // Conexões a ser atendidas pelo worker
+
+// Leitura consistente (seqlock) e agregada de todos os slots
+void stats_snapshot(ipc_handles_t *handles, server_stats_t *out);
+void stats_tick(ipc_handles_t *handles); // Master, 1x por segundo: janela deslizante, anel por segundo e fotografia
+void stats_published(ipc_handles_t *handles, server_stats_t *out); // Última fotografia do stats_tick (conexões ativas ao vivo)
+int stats_history(ipc_handles_t *handles, second_stats_t *out, int max); // Últimos segundos, mais recente primeiro
+void stats_rates(ipc_handles_t *handles, int seconds, rate_stats_t *out); // Médias dos últimos "seconds" segundos
+void stats_cache_totals(ipc_handles_t *handles, cache_stats_t *total); // Soma das caches de todos os workers
+void stats_worker_cache(ipc_handles_t *handles, int worker_id, cache_stats_t *out);
+void stats_worker_proc(ipc_handles_t *handles, int worker_id, proc_stats_t *out);
+void stats_worker_mem(ipc_handles_t *handles, int worker_id, mem_stats_t *out);
+void stats_tcp(ipc_handles_t *handles, int vhost, tcp_stats_t *out); // Soma de todos os workers
+void stats_sample_queue(ipc_handles_t *handles, int listen_fd); // Master, 1x por segundo: fila de accept do kernel
+void stats_top_paths(ipc_handles_t *handles, int by_bytes, path_rate_t *out); // Top TOPN_PUBLISH de todos os workers
+int stats_slow_requests(ipc_handles_t *handles, slow_entry_t *out, int max); // Anéis de todos os workers, mais recentes primeiro
+int stats_format_slow(const slow_entry_t *e, char *buf, size_t len); // Uma linha de texto
+void stats_dump_slow(ipc_handles_t *handles); // SIGUSR1 no master
 void stats_display(ipc_handles_t *handles);
-void stats_record_response_time(ipc_handles_t *handles, struct timespec *start_time);
 
 int master_init(server_config_t *config);
 void master_accept_loop(void);
@@ -0,0 +1,141 @@
+#define _POSIX_C_SOURCE 200809L
+#include "mempressure.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SHRINK_PRESSURE 10.0 // PSI some avg10 (%) a partir do qual a cache encolhe
+#define SHRINK_USAGE 0.90    // ...ou fração do limite do cgroup (sem a page cache inativa)
+#define GROW_PRESSURE 1.0    // Só cresce abaixo destes valores
+#define GROW_USAGE 0.75
+
+static char g_current_path[512];
+static char g_max_path[512];
+static char g_stat_path[512];
+static char g_pressure_path[512];
+static int g_use_meminfo = 0; // Sem limite no cgroup: usa a memória do sistema
+static int g_have_usage = 0;  // Sinais encontrados no arranque
+static int g_have_pressure = 0;
+
+static int read_u64(const char *path, unsigned long long *value) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    char buf[64];
+    int ok = fgets(buf, sizeof(buf), f) != NULL;
+    fclose(f);
+    // "max" = sem limite
+    if (!ok || sscanf(buf, "%llu", value) != 1) return -1;
+    return 0;
+}
+
+static int readable(const char *path) {
+    return path[0] && access(path, R_OK) == 0;
+}
+
+int mempressure_init(void) {
+    g_current_path[0] = g_max_path[0] = g_stat_path[0] = g_pressure_path[0] = '\0';
+
+    // cgroup v2: linha "0::/caminho"
+    FILE *f = fopen("/proc/self/cgroup", "r");
+    if (f) {
+        char line[400];
+        while (fgets(line, sizeof(line), f)) {
+            if (strncmp(line, "0::", 3) != 0) continue;
+            line[strcspn(line, "\n")] = '\0';
+            const char *cg = line + 3;
+            if (strcmp(cg, "/") == 0) cg = "";
+            snprintf(g_current_path, sizeof(g_current_path), "/sys/fs/cgroup%s/memory.current", cg);
+            snprintf(g_max_path, sizeof(g_max_path), "/sys/fs/cgroup%s/memory.max", cg);
+            snprintf(g_stat_path, sizeof(g_stat_path), "/sys/fs/cgroup%s/memory.stat", cg);
+            snprintf(g_pressure_path, sizeof(g_pressure_path), "/sys/fs/cgroup%s/memory.pressure", cg);
+            break;
+        }
+        fclose(f);
+    }
+
+    unsigned long long limit;
+    g_use_meminfo = !(readable(g_current_path) && read_u64(g_max_path, &limit) == 0);
+    if (!readable(g_pressure_path)) {
+        snprintf(g_pressure_path, sizeof(g_pressure_path), "/proc/pressure/memory");
+    }
+
+    g_have_usage = g_use_meminfo ? access("/proc/meminfo", R_OK) == 0 : readable(g_stat_path);
+    g_have_pressure = readable(g_pressure_path);
+    return (g_have_usage || g_have_pressure) ? 0 : -1;
+}
+
+static double meminfo_usage(void) {
+    FILE *f = fopen("/proc/meminfo", "r");
+    if (!f) return -1;
+    char line[128];
+    unsigned long long total = 0, avail = 0, v;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "MemTotal: %llu", &v) == 1) total = v;
+        else if (sscanf(line, "MemAvailable: %llu", &v) == 1) avail = v;
+    }
+    fclose(f);
+    return total ? 1.0 - (double)avail / total : -1;
+}
+
+// memory.current inclui a page cache: num servidor de ficheiros estáticos fica perto do limite
+// sem pressão nenhuma. A parte inativa (inactive_file) é recuperada sem esforço, por isso não conta.
+static double cgroup_usage(void) {
+    unsigned long long current, limit;
+    if (read_u64(g_current_path, &current) != 0 || read_u64(g_max_path, &limit) != 0 || limit == 0) return -1;
+
+    FILE *f = fopen(g_stat_path, "r");
+    if (!f) return -1;
+    char line[128];
+    unsigned long long inactive = 0, v;
+    int found = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "inactive_file %llu", &v) == 1) {
+            inactive = v;
+            found = 1;
+            break;
+        }
+    }
+    fclose(f);
+    if (!found) return -1;
+    if (inactive > current) inactive = current;
+    return (double)(current - inactive) / limit;
+}
+
+void mempressure_sample(mem_sample_t *sample) {
+    sample->usage = -1;
+    sample->pressure = -1;
+    sample->missing = 0;
+
+    if (g_have_usage) {
+        sample->usage = g_use_meminfo ? meminfo_usage() : cgroup_usage();
+        if (sample->usage < 0) sample->missing++;
+    }
+
+    // "some avg10=0.00 avg60=0.00 avg300=0.00 total=0"
+    if (g_have_pressure) {
+        FILE *f = fopen(g_pressure_path, "r");
+        if (f) {
+            double avg10;
+            if (fscanf(f, "some avg10=%lf", &avg10) == 1) sample->pressure = avg10;
+            fclose(f);
+        }
+        if (sample->pressure < 0) sample->missing++;
+    }
+}
+
+size_t mempressure_target(const mem_sample_t *sample, size_t current, size_t min, size_t max) {
+    size_t target = current;
+    int read_any = sample->usage >= 0 || sample->pressure >= 0;
+
+    // -1 é "não sei", não "calmo": sem leitura completa mantém o orçamento
+    if (sample->pressure >= SHRINK_PRESSURE || sample->usage >= SHRINK_USAGE) {
+        target = current - current / 4;
+    } else if (read_any && sample->missing == 0 &&
+               sample->pressure < GROW_PRESSURE && sample->usage < GROW_USAGE) {
+        target = current + max / 16;
+    }
+
+    if (target < min) target = min;
+    if (target > max) target = max;
+    return target;
+}
@@ -0,0 +1,24 @@
+#ifndef MEMPRESSURE_H
+#define MEMPRESSURE_H
+
+#include <stddef.h>
+
+// Leitura da pressão de memória para o orçamento adaptativo da cache (CACHE_ADAPTIVE).
+// Usa o cgroup v2 do processo (memory.current/memory.max/memory.pressure) e, sem
+// limite de cgroup, /proc/meminfo e /proc/pressure/memory.
+typedef struct {
+    double usage;    // Fração do limite em uso, sem a page cache inativa (0..1), -1 se desconhecida
+    double pressure; // PSI "some avg10" (% do tempo com tarefas à espera de memória), -1 se indisponível
+    int missing;     // Sinais que existiam no arranque mas não foi possível ler desta vez
+} mem_sample_t;
+
+// Descobre os ficheiros a ler. Devolve -1 se não houver nenhum sinal disponível.
+int mempressure_init(void);
+
+void mempressure_sample(mem_sample_t *sample);
+
+// Próximo orçamento da cache: encolhe depressa com pressão, cresce devagar sem ela.
+// Só cresce quando todos os sinais disponíveis foram lidos e estão calmos.
+size_t mempressure_target(const mem_sample_t *sample, size_t current, size_t min, size_t max);
+
+#endif
@@ -0,0 +1,58 @@
+#include "memstat.h"
+#include <stddef.h>
+#include <errno.h>
+
+#ifdef ALLOC_STATS
+// Implementação da glibc (exportada para quem substitui o malloc)
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+// Só contadores da própria thread: nada partilhado no caminho da alocação
+static inline void count_alloc(size_t size) {
+    memstat_thread_allocs.count++;
+    memstat_thread_allocs.bytes += size;
+}
+
+void *malloc(size_t size) {
+    count_alloc(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+    count_alloc(n * size);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    count_alloc(size);
+    return __libc_realloc(ptr, size);
+}
+
+// Variantes alinhadas: sem elas estas alocações não entravam na contagem
+void *memalign(size_t alignment, size_t size) {
+    count_alloc(size);
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    count_alloc(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **out, size_t alignment, size_t size) {
+    // Mesmas regras da glibc: potência de 2 e múltiplo de sizeof(void*)
+    if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0 || alignment == 0) return EINVAL;
+    count_alloc(size);
+    void *p = __libc_memalign(alignment, size);
+    if (!p) return ENOMEM;
+    *out = p;
+    return 0;
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+#endif
@@ -0,0 +1,17 @@
+#ifndef MEMSTAT_H
+#define MEMSTAT_H
+
+#include <stdint.h>
+
+// Alocações feitas por esta thread desde que arrancou. Com -DALLOC_STATS o servidor substitui
+// malloc, calloc, realloc e as variantes alinhadas por versões que só somam a este contador e
+// chamam as da glibc, por isso também contam as alocações internas da libc (fopen, strdup...).
+// Sem essa flag o allocator fica intacto e o contador a zero.
+typedef struct {
+    uint64_t count;
+    uint64_t bytes;
+} alloc_counter_t;
+
+extern __thread alloc_counter_t memstat_thread_allocs;
+
+#endif
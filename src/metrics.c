@@ -0,0 +1,311 @@
+#define _POSIX_C_SOURCE 200809L
+#include "metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+// Limites dos buckets exportados (us). O histograma interno tem 464 buckets: agrupados nestes.
+static const uint64_t g_bounds_us[] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000,
+    1000000, 2500000, 5000000, 10000000
+};
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    int failed;
+} out_t;
+
+static void out_printf(out_t *o, const char *fmt, ...) {
+    if (o->failed) return;
+    for (;;) {
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(o->data + o->len, o->cap - o->len, fmt, ap);
+        va_end(ap);
+        if (n < 0) { o->failed = 1; return; }
+        if ((size_t)n < o->cap - o->len) { o->len += n; return; }
+
+        size_t cap = o->cap * 2;
+        while (cap - o->len <= (size_t)n) cap *= 2;
+        char *data = realloc(o->data, cap);
+        if (!data) { o->failed = 1; return; }
+        o->data = data;
+        o->cap = cap;
+    }
+}
+
+static void header(out_t *o, const char *name, const char *type, const char *help) {
+    out_printf(o, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+// Valor de label: escapa \\, " e quebras de linha
+static void label_value(out_t *o, const char *str) {
+    for (const char *p = str; *p; p++) {
+        if (*p == '\\' || *p == '"') out_printf(o, "\\%c", *p);
+        else if (*p == '\n') out_printf(o, "\\n");
+        else out_printf(o, "%c", *p);
+    }
+}
+
+static void top_paths(out_t *o, ipc_handles_t *ipc, int by_bytes, const char *name) {
+    path_rate_t top[TOPN_PUBLISH];
+    stats_top_paths(ipc, by_bytes, top);
+    for (int k = 0; k < TOPN_PUBLISH && top[k].path[0]; k++) {
+        out_printf(o, "%s{path=\"", name);
+        label_value(o, top[k].path);
+        out_printf(o, "\"} %.2f\n", top[k].rate);
+    }
+}
+
+// Histograma com labels opcionais (ex: stage="disk"); os buckets vão em segundos
+static void histogram(out_t *o, const char *name, const char *labels, const hist_t *h) {
+    const char *sep = labels[0] ? "," : "";
+    for (size_t i = 0; i < sizeof(g_bounds_us) / sizeof(g_bounds_us[0]); i++) {
+        out_printf(o, "%s_bucket{%s%sle=\"%g\"} %lu\n", name, labels, sep,
+                   g_bounds_us[i] / 1e6, hist_count_le(h, g_bounds_us[i]));
+    }
+    out_printf(o, "%s_bucket{%s%sle=\"+Inf\"} %lu\n", name, labels, sep, h->count);
+    if (labels[0]) {
+        out_printf(o, "%s_sum{%s} %.6f\n", name, labels, h->sum_us / 1e6);
+        out_printf(o, "%s_count{%s} %lu\n", name, labels, h->count);
+    } else {
+        out_printf(o, "%s_sum %.6f\n", name, h->sum_us / 1e6);
+        out_printf(o, "%s_count %lu\n", name, h->count);
+    }
+}
+
+// Uma série por worker
+#define PER_WORKER(o, n, name, fmt, expr) \
+    for (int w = 0; w < (n); w++) out_printf((o), name "{worker=\"%d\"} " fmt "\n", w, (expr))
+
+char* metrics_render(ipc_handles_t *ipc, size_t *len) {
+    if (!ipc || !ipc->shared_data) return NULL;
+    shared_data_t *shm = ipc->shared_data;
+
+    server_stats_t s;
+    stats_published(ipc, &s);
+
+    int workers = shm->num_workers < MAX_WORKERS ? shm->num_workers : MAX_WORKERS;
+    cache_stats_t cache[MAX_WORKERS];
+    proc_stats_t proc[MAX_WORKERS];
+    mem_stats_t mem[MAX_WORKERS];
+    for (int w = 0; w < workers; w++) {
+        stats_worker_cache(ipc, w, &cache[w]);
+        stats_worker_proc(ipc, w, &proc[w]);
+        stats_worker_mem(ipc, w, &mem[w]);
+    }
+
+    out_t o = { .data = malloc(16384), .cap = 16384 };
+    if (!o.data) return NULL;
+
+    header(&o, "http_requests_total", "counter", "Requests served");
+    out_printf(&o, "http_requests_total %lu\n", s.total_requests);
+
+    header(&o, "http_response_bytes_total", "counter", "Body bytes sent");
+    out_printf(&o, "http_response_bytes_total %lu\n", s.bytes_transferred);
+
+    header(&o, "http_responses_total", "counter", "Responses by status class");
+    for (int c = 1; c < STATUS_CLASSES; c++) {
+        out_printf(&o, "http_responses_total{class=\"%dxx\"} %lu\n", c, s.status_class[c]);
+    }
+    out_printf(&o, "http_responses_total{class=\"other\"} %lu\n", s.status_class[0]);
+
+    // Médias do anel por segundo do master (mudam logo, ao contrário dos totais desde o arranque)
+    static const int windows[RATE_WINDOW_COUNT] = RATE_WINDOWS;
+    rate_stats_t rates[RATE_WINDOW_COUNT];
+    for (int r = 0; r < RATE_WINDOW_COUNT; r++) stats_rates(ipc, windows[r], &rates[r]);
+    header(&o, "http_requests_per_second", "gauge", "Average requests per second over the last window");
+    for (int r = 0; r < RATE_WINDOW_COUNT; r++) {
+        out_printf(&o, "http_requests_per_second{window=\"%ds\"} %.2f\n", windows[r], rates[r].requests);
+    }
+    header(&o, "http_response_bytes_per_second", "gauge", "Average body bytes sent per second over the last window");
+    for (int r = 0; r < RATE_WINDOW_COUNT; r++) {
+        out_printf(&o, "http_response_bytes_per_second{window=\"%ds\"} %.0f\n", windows[r], rates[r].bytes);
+    }
+    header(&o, "http_responses_per_second", "gauge", "Average responses per second by status class over the last window");
+    for (int r = 0; r < RATE_WINDOW_COUNT; r++) {
+        for (int c = 1; c < STATUS_CLASSES; c++) {
+            out_printf(&o, "http_responses_per_second{window=\"%ds\",class=\"%dxx\"} %.2f\n", windows[r], c, rates[r].status_class[c]);
+        }
+    }
+    static const uint64_t rate_bounds[RATE_BUCKETS - 1] = RATE_BOUNDS_US;
+    header(&o, "http_recent_requests", "gauge", "Requests finished in the last window, cumulative by duration (upto, in seconds)");
+    for (int r = 0; r < RATE_WINDOW_COUNT; r++) {
+        uint64_t cumulative = 0;
+        for (int b = 0; b < RATE_BUCKETS; b++) {
+            cumulative += rates[r].latency[b];
+            if (b < RATE_BUCKETS - 1) {
+                out_printf(&o, "http_recent_requests{window=\"%ds\",upto=\"%g\"} %lu\n", windows[r], rate_bounds[b] / 1e6, cumulative);
+            } else {
+                out_printf(&o, "http_recent_requests{window=\"%ds\",upto=\"+Inf\"} %lu\n", windows[r], cumulative);
+            }
+        }
+    }
+
+    header(&o, "http_responses_by_code_total", "counter", "Responses with the status codes the server emits");
+    out_printf(&o, "http_responses_by_code_total{code=\"200\"} %lu\n", s.status_200);
+    out_printf(&o, "http_responses_by_code_total{code=\"403\"} %lu\n", s.status_403);
+    out_printf(&o, "http_responses_by_code_total{code=\"404\"} %lu\n", s.status_404);
+    out_printf(&o, "http_responses_by_code_total{code=\"500\"} %lu\n", s.status_500);
+    out_printf(&o, "http_responses_by_code_total{code=\"503\"} %lu\n", s.status_503);
+
+    header(&o, "http_active_connections", "gauge", "Connections being handled");
+    out_printf(&o, "http_active_connections %u\n", s.active_connections);
+
+    header(&o, "http_accept_queue_depth", "gauge", "Connections waiting in the listen backlog");
+    out_printf(&o, "http_accept_queue_depth %u\n", __atomic_load_n(&shm->accept_queue, __ATOMIC_RELAXED));
+    header(&o, "http_accept_queue_limit", "gauge", "Listen backlog size");
+    out_printf(&o, "http_accept_queue_limit %u\n", __atomic_load_n(&shm->accept_backlog, __ATOMIC_RELAXED));
+
+    header(&o, "http_start_time_seconds", "gauge", "Server start time (unix epoch)");
+    out_printf(&o, "http_start_time_seconds %ld\n", (long)s.start_time);
+
+    header(&o, "http_request_duration_seconds", "histogram", "Request duration");
+    histogram(&o, "http_request_duration_seconds", "", &s.latency);
+
+    header(&o, "http_request_cpu_seconds", "histogram", "Thread CPU time per request");
+    histogram(&o, "http_request_cpu_seconds", "", &s.cpu);
+
+    static const char *stage_names[] = STAGE_NAMES;
+    header(&o, "http_request_stage_duration_seconds", "histogram", "Time per request stage (only requests that went through it)");
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        char label[32];
+        snprintf(label, sizeof(label), "stage=\"%s\"", stage_names[i]);
+        histogram(&o, "http_request_stage_duration_seconds", label, &s.stages[i]);
+    }
+
+    // TCP_INFO amostrado ao fechar, por virtual host
+    static const char *vhost_names[] = VHOST_NAMES;
+    tcp_stats_t tcp[VHOST_COUNT];
+    for (int v = 0; v < VHOST_COUNT; v++) stats_tcp(ipc, v, &tcp[v]);
+    header(&o, "http_tcp_rtt_seconds", "histogram", "Kernel smoothed RTT of sampled connections at close");
+    for (int v = 0; v < VHOST_COUNT; v++) {
+        char label[32];
+        snprintf(label, sizeof(label), "vhost=\"%s\"", vhost_names[v]);
+        histogram(&o, "http_tcp_rtt_seconds", label, &tcp[v].rtt);
+    }
+    header(&o, "http_tcp_delivery_rate_bytes", "gauge", "Delivery rate of sampled connections (bytes/s) by percentile");
+    for (int v = 0; v < VHOST_COUNT; v++) {
+        static const double percentiles[] = { 50, 90, 99 };
+        for (int q = 0; q < 3; q++) {
+            out_printf(&o, "http_tcp_delivery_rate_bytes{vhost=\"%s\",pct=\"%g\"} %lu\n", vhost_names[v],
+                       percentiles[q], hist_percentile(&tcp[v].delivery, percentiles[q]) * 1024);
+        }
+    }
+    header(&o, "http_tcp_samples_total", "counter", "Connections sampled with TCP_INFO");
+    for (int v = 0; v < VHOST_COUNT; v++) out_printf(&o, "http_tcp_samples_total{vhost=\"%s\"} %lu\n", vhost_names[v], tcp[v].samples);
+    header(&o, "http_tcp_retransmits_total", "counter", "Segments retransmitted on sampled connections");
+    for (int v = 0; v < VHOST_COUNT; v++) out_printf(&o, "http_tcp_retransmits_total{vhost=\"%s\"} %lu\n", vhost_names[v], tcp[v].retransmits);
+    header(&o, "http_tcp_retransmitted_connections_total", "counter", "Sampled connections with at least one retransmit");
+    for (int v = 0; v < VHOST_COUNT; v++) out_printf(&o, "http_tcp_retransmitted_connections_total{vhost=\"%s\"} %lu\n", vhost_names[v], tcp[v].retransmitted);
+    header(&o, "http_tcp_unacked_at_close_total", "counter", "Sampled connections closed with data not yet acknowledged by the client");
+    for (int v = 0; v < VHOST_COUNT; v++) out_printf(&o, "http_tcp_unacked_at_close_total{vhost=\"%s\"} %lu\n", vhost_names[v], tcp[v].unacked);
+    header(&o, "http_tcp_bytes_acked_total", "counter", "Bytes acknowledged by clients on sampled connections");
+    for (int v = 0; v < VHOST_COUNT; v++) out_printf(&o, "http_tcp_bytes_acked_total{vhost=\"%s\"} %lu\n", vhost_names[v], tcp[v].bytes_acked);
+    header(&o, "http_tcp_cwnd_segments", "gauge", "Average congestion window of sampled connections");
+    for (int v = 0; v < VHOST_COUNT; v++) {
+        out_printf(&o, "http_tcp_cwnd_segments{vhost=\"%s\"} %.1f\n", vhost_names[v],
+                   tcp[v].samples ? (double)tcp[v].cwnd_sum / tcp[v].samples : 0.0);
+    }
+
+    // Cache: uma série por worker (cada worker tem a sua)
+    header(&o, "http_cache_hits_total", "counter", "Cache hits, including the per-thread L1");
+    PER_WORKER(&o, workers, "http_cache_hits_total", "%lu", cache[w].hits);
+    header(&o, "http_cache_l1_hits_total", "counter", "Cache hits served by the per-thread L1");
+    PER_WORKER(&o, workers, "http_cache_l1_hits_total", "%lu", cache[w].l1_hits);
+    header(&o, "http_cache_misses_total", "counter", "Cache misses");
+    PER_WORKER(&o, workers, "http_cache_misses_total", "%lu", cache[w].misses);
+
+    header(&o, "http_cache_evictions_total", "counter", "Cache evictions by reason");
+    for (int w = 0; w < workers; w++) {
+        out_printf(&o, "http_cache_evictions_total{worker=\"%d\",reason=\"capacity\"} %lu\n", w, cache[w].evictions_capacity);
+        out_printf(&o, "http_cache_evictions_total{worker=\"%d\",reason=\"stale\"} %lu\n", w, cache[w].evictions_stale);
+        out_printf(&o, "http_cache_evictions_total{worker=\"%d\",reason=\"resize\"} %lu\n", w, cache[w].evictions_resize);
+    }
+    header(&o, "http_cache_rejects_total", "counter", "Objects not cached, by reason");
+    for (int w = 0; w < workers; w++) {
+        out_printf(&o, "http_cache_rejects_total{worker=\"%d\",reason=\"admission\"} %lu\n", w, cache[w].admission_rejects);
+        out_printf(&o, "http_cache_rejects_total{worker=\"%d\",reason=\"size\"} %lu\n", w, cache[w].size_rejects);
+    }
+
+    header(&o, "http_cache_fills_total", "counter", "Cache fills from disk");
+    PER_WORKER(&o, workers, "http_cache_fills_total", "%lu", cache[w].fills);
+    header(&o, "http_cache_fill_seconds_total", "counter", "Time spent filling the cache from disk");
+    PER_WORKER(&o, workers, "http_cache_fill_seconds_total", "%.6f", cache[w].fill_time_us / 1e6);
+
+    header(&o, "http_cache_bytes", "gauge", "Bytes held by the cache");
+    PER_WORKER(&o, workers, "http_cache_bytes", "%lu", cache[w].bytes_used);
+    header(&o, "http_cache_budget_bytes", "gauge", "Current cache budget");
+    PER_WORKER(&o, workers, "http_cache_budget_bytes", "%lu", cache[w].bytes_budget);
+    header(&o, "http_cache_entries", "gauge", "Objects in the cache");
+    PER_WORKER(&o, workers, "http_cache_entries", "%lu", cache[w].entries);
+
+    // Processo de cada worker (atualizado 1x por segundo)
+    header(&o, "http_worker_resident_memory_bytes", "gauge", "Worker resident set size");
+    PER_WORKER(&o, workers, "http_worker_resident_memory_bytes", "%lu", proc[w].rss_bytes);
+    header(&o, "http_worker_page_faults_total", "counter", "Worker page faults by type");
+    for (int w = 0; w < workers; w++) {
+        out_printf(&o, "http_worker_page_faults_total{worker=\"%d\",type=\"minor\"} %lu\n", w, proc[w].minor_faults);
+        out_printf(&o, "http_worker_page_faults_total{worker=\"%d\",type=\"major\"} %lu\n", w, proc[w].major_faults);
+    }
+    header(&o, "http_worker_context_switches_total", "counter", "Worker context switches by type (all threads)");
+    for (int w = 0; w < workers; w++) {
+        out_printf(&o, "http_worker_context_switches_total{worker=\"%d\",type=\"voluntary\"} %lu\n", w, proc[w].voluntary_switches);
+        out_printf(&o, "http_worker_context_switches_total{worker=\"%d\",type=\"involuntary\"} %lu\n", w, proc[w].involuntary_switches);
+    }
+    header(&o, "http_worker_context_switches_per_request", "gauge", "Context switches per request over the last second");
+    PER_WORKER(&o, workers, "http_worker_context_switches_per_request", "%.3f", proc[w].switches_per_request);
+
+    header(&o, "http_worker_memory_bytes", "gauge", "Worker memory by area (heap_* from mallinfo2)");
+    for (int w = 0; w < workers; w++) {
+        const struct { const char *area; uint64_t bytes; } areas[] = {
+            { "cache_data", cache[w].data_bytes }, { "cache_meta", cache[w].meta_bytes },
+            { "cache_reserved", cache[w].reserved_bytes }, { "conn_buffers", mem[w].conn_buffers },
+            { "log_buffers", mem[w].log_buffers }, { "heap_arena", mem[w].heap_arena },
+            { "heap_mmap", mem[w].heap_mmap }, { "heap_in_use", mem[w].heap_in_use },
+            { "heap_free", mem[w].heap_free }
+        };
+        for (size_t a = 0; a < sizeof(areas) / sizeof(areas[0]); a++) {
+            out_printf(&o, "http_worker_memory_bytes{worker=\"%d\",area=\"%s\"} %lu\n", w, areas[a].area, areas[a].bytes);
+        }
+    }
+    header(&o, "http_request_allocations_total", "counter", "Allocator calls made while handling requests (zero unless built with -DALLOC_STATS)");
+    out_printf(&o, "http_request_allocations_total %lu\n", s.request_allocs);
+    header(&o, "http_request_allocated_bytes_total", "counter", "Bytes requested from malloc while handling requests");
+    out_printf(&o, "http_request_allocated_bytes_total %lu\n", s.request_alloc_bytes);
+    header(&o, "http_request_allocations_max", "gauge", "Most allocations made by a single request");
+    out_printf(&o, "http_request_allocations_max %lu\n", s.request_allocs_max);
+
+    // Contadores de hardware (PERF_COUNTERS): só os workers que os conseguiram abrir
+    int hw = 0;
+    for (int w = 0; w < workers; w++) hw |= proc[w].perf_enabled == 2;
+    if (hw) {
+        header(&o, "http_worker_cpu_cycles_total", "counter", "CPU cycles spent by request threads");
+        PER_WORKER(&o, workers, "http_worker_cpu_cycles_total", "%lu", proc[w].cycles);
+        header(&o, "http_worker_instructions_total", "counter", "Instructions retired by request threads");
+        PER_WORKER(&o, workers, "http_worker_instructions_total", "%lu", proc[w].instructions);
+        header(&o, "http_worker_cache_misses_total", "counter", "Last-level cache misses of request threads");
+        PER_WORKER(&o, workers, "http_worker_cache_misses_total", "%lu", proc[w].cache_misses);
+        header(&o, "http_worker_cycles_per_request", "gauge", "CPU cycles per request over the last second");
+        PER_WORKER(&o, workers, "http_worker_cycles_per_request", "%.0f", proc[w].cycles_per_request);
+        header(&o, "http_worker_instructions_per_cycle", "gauge", "Instructions per cycle of request threads over the last second");
+        PER_WORKER(&o, workers, "http_worker_instructions_per_cycle", "%.3f", proc[w].instructions_per_cycle);
+        header(&o, "http_worker_cache_misses_per_request", "gauge", "Cache misses per request over the last second");
+        PER_WORKER(&o, workers, "http_worker_cache_misses_per_request", "%.1f", proc[w].cache_misses_per_request);
+    }
+
+    // Caminhos mais pedidos: média exponencial de ~1 minuto (no máximo TOPN_PUBLISH séries)
+    header(&o, "http_top_path_requests_per_second", "gauge", "Busiest paths by request rate");
+    top_paths(&o, ipc, 0, "http_top_path_requests_per_second");
+    header(&o, "http_top_path_bytes_per_second", "gauge", "Busiest paths by bytes sent");
+    top_paths(&o, ipc, 1, "http_top_path_bytes_per_second");
+
+    if (o.failed) {
+        free(o.data);
+        return NULL;
+    }
+    *len = o.len;
+    return o.data;
+}
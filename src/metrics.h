@@ -0,0 +1,12 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include "master.h"
+
+// Texto no formato de exposição do Prometheus (/metrics), gerado a partir da mesma
+// fotografia dos slots usada pelo /stats (leituras seqlock, sem bloquear os workers).
+// Devolve um buffer alocado (libertar com free) ou NULL.
+char* metrics_render(ipc_handles_t *ipc, size_t *len);
+
+#endif
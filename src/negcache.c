@@ -0,0 +1,332 @@
+#define _GNU_SOURCE
+#include "negcache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <ftw.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/inotify.h>
+
+#define NEG_SLOTS 1024         // Entradas da cache negativa (mapeamento direto)
+#define BLOOM_BITS_PER_KEY 10  // ~1% de falsos positivos
+#define BLOOM_HASHES 7
+#define BLOOM_MIN_BITS 1024
+#define REBUILD_DEBOUNCE_MS 100 // Agrupa rajadas de eventos (ex: deploy) numa só reconstrução
+#define READER_SLOTS 64         // Contadores de leitores do filtro (um por thread; as excedentes partilham)
+
+typedef struct bloom {
+    uint64_t *bits;
+    uint64_t mask;      // Número de bits - 1 (potência de 2)
+    struct bloom *next; // Lista de filtros retirados
+} bloom_t;
+
+// Cada slot é uma só palavra atómica: 32 bits altos do hash | expiração (segundos, 32 bits).
+// Leitores e escritores nunca bloqueiam; uma escrita concorrente só troca o slot inteiro.
+static uint64_t g_neg[NEG_SLOTS];
+static int g_neg_ttl = 0;
+
+// Filtro ativo, publicado por troca atómica do ponteiro. Os substituídos ficam retirados até
+// uma altura em que nenhum leitor esteja a consultar um filtro (todos os contadores a zero).
+static bloom_t *g_bloom = NULL;
+static bloom_t *g_bloom_retired = NULL; // Só a thread do inotify (ou init/cleanup) mexe na lista
+
+// Cada thread conta as suas consultas em curso numa linha de cache própria: sem contenção no pedido
+typedef struct {
+    uint64_t active;
+} __attribute__((aligned(64))) reader_slot_t;
+
+static reader_slot_t g_readers[READER_SLOTS];
+static int g_next_reader = 0;
+static __thread int tls_reader = -1;
+static int g_bloom_stale = 0; // Há eventos do inotify mais recentes do que o filtro
+static int g_filter = 0; // DOCROOT_FILTER ativo
+static char g_doc_root[256];
+static size_t g_doc_root_len = 0;
+
+static char *g_404 = NULL; // Resposta 404 pré-construída
+static size_t g_404_len = 0;
+
+static pthread_t g_watch_thread;
+static int g_watch_started = 0;
+static volatile int g_watch_stop = 0;
+
+// Estado da travessia (nftw não aceita argumento de utilizador)
+static uint64_t *g_walk_hashes = NULL;
+static size_t g_walk_len = 0, g_walk_cap = 0;
+static int g_walk_inotify = -1;
+
+// FNV-1a de 64 bits
+static uint64_t hash_path(const char *s) {
+    uint64_t h = 1469598103934665603ULL;
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static int walk_cb(const char *fpath, const struct stat *sb, int typeflag, struct FTW *ftwbuf) {
+    (void)sb; (void)ftwbuf;
+    if (typeflag == FTW_D) {
+        if (g_walk_inotify >= 0) {
+            inotify_add_watch(g_walk_inotify, fpath,
+                IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF);
+        }
+    } else if (typeflag == FTW_F) {
+        if (g_walk_len == g_walk_cap) {
+            size_t cap = g_walk_cap ? g_walk_cap * 2 : 256;
+            uint64_t *h = realloc(g_walk_hashes, cap * sizeof(uint64_t));
+            if (!h) return -1;
+            g_walk_hashes = h;
+            g_walk_cap = cap;
+        }
+        g_walk_hashes[g_walk_len++] = hash_path(fpath);
+    }
+    return 0;
+}
+
+static inline uint64_t bloom_bit(const bloom_t *b, uint64_t hash, int i) {
+    uint64_t h2 = (hash >> 32) | 1;
+    return (hash + (uint64_t)i * h2) & b->mask;
+}
+
+// Percorre a DOCUMENT_ROOT, constrói um Bloom filter novo e (re)instala os watches
+static bloom_t* bloom_build(int inotify_fd) {
+    g_walk_len = 0;
+    g_walk_inotify = inotify_fd;
+    // Segue links simbólicos (o fopen também segue); o nftw não visita o mesmo diretório duas vezes
+    if (nftw(g_doc_root, walk_cb, 16, 0) != 0) return NULL;
+
+    bloom_t *b = malloc(sizeof(bloom_t));
+    if (!b) return NULL;
+    uint64_t nbits = BLOOM_MIN_BITS;
+    while (nbits < g_walk_len * BLOOM_BITS_PER_KEY) nbits <<= 1;
+    b->mask = nbits - 1;
+    b->next = NULL;
+    b->bits = calloc(nbits / 64, sizeof(uint64_t));
+    if (!b->bits) {
+        free(b);
+        return NULL;
+    }
+
+    for (size_t k = 0; k < g_walk_len; k++) {
+        for (int i = 0; i < BLOOM_HASHES; i++) {
+            uint64_t bit = bloom_bit(b, g_walk_hashes[k], i);
+            b->bits[bit / 64] |= 1ULL << (bit % 64);
+        }
+    }
+    return b;
+}
+
+static void bloom_free(bloom_t *b) {
+    if (!b) return;
+    free(b->bits);
+    free(b);
+}
+
+static int bloom_contains(const bloom_t *b, uint64_t hash) {
+    for (int i = 0; i < BLOOM_HASHES; i++) {
+        uint64_t bit = bloom_bit(b, hash, i);
+        if (!(b->bits[bit / 64] & (1ULL << (bit % 64)))) return 0;
+    }
+    return 1;
+}
+
+// Liberta os filtros retirados se nenhum leitor estiver dentro de uma consulta. Um leitor que
+// entre depois desta verificação já lê o ponteiro novo (troca e contadores são seq_cst).
+static void bloom_reclaim(void) {
+    if (!g_bloom_retired) return;
+    for (int i = 0; i < READER_SLOTS; i++) {
+        if (__atomic_load_n(&g_readers[i].active, __ATOMIC_SEQ_CST) != 0) return;
+    }
+    while (g_bloom_retired) {
+        bloom_t *next = g_bloom_retired->next;
+        bloom_free(g_bloom_retired);
+        g_bloom_retired = next;
+    }
+}
+
+// Troca o filtro ativo e esquece os negativos (podem ter sido criados ficheiros)
+static void bloom_install(bloom_t *b) {
+    bloom_t *old = __atomic_exchange_n(&g_bloom, b, __ATOMIC_SEQ_CST);
+    if (old) {
+        old->next = g_bloom_retired;
+        g_bloom_retired = old;
+    }
+    bloom_reclaim();
+
+    for (int i = 0; i < NEG_SLOTS; i++) __atomic_store_n(&g_neg[i], 0, __ATOMIC_RELAXED);
+}
+
+// Thread que reconstrói o filtro sempre que algo muda na DOCUMENT_ROOT
+static void *watch_thread_fn(void *arg) {
+    int fd = (int)(intptr_t)arg;
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (!g_watch_stop) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        if (poll(&pfd, 1, 500) <= 0) {
+            bloom_reclaim(); // Filtros retirados que ainda tinham leitores na troca
+            continue;
+        }
+        if (read(fd, buf, sizeof(buf)) <= 0) continue;
+
+        // Até haver um filtro construído depois deste evento, um "não está no filtro" não é definitivo
+        __atomic_store_n(&g_bloom_stale, 1, __ATOMIC_RELEASE);
+
+        // Espera que a rajada acabe, descartando os eventos entretanto
+        while (poll(&pfd, 1, REBUILD_DEBOUNCE_MS) > 0 && read(fd, buf, sizeof(buf)) > 0);
+
+        // Novo descritor: os watches de diretórios novos são criados durante a travessia
+        int new_fd = inotify_init1(IN_CLOEXEC);
+        if (new_fd < 0) continue;
+        bloom_t *b = bloom_build(new_fd);
+        if (!b) {
+            close(new_fd);
+            continue;
+        }
+        close(fd);
+        fd = new_fd;
+        bloom_install(b);
+
+        // Mudanças durante a travessia ainda estão por tratar: o filtro continua desatualizado
+        struct pollfd pending = { .fd = fd, .events = POLLIN };
+        if (poll(&pending, 1, 0) == 0) __atomic_store_n(&g_bloom_stale, 0, __ATOMIC_RELEASE);
+    }
+
+    close(fd);
+    return NULL;
+}
+
+// Lê errors/404.html uma vez e guarda a resposta completa
+static void build_404(void) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/errors/404.html", g_doc_root);
+    FILE *f = fopen(path, "rb");
+    if (!f) return;
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char header[256];
+    int hlen = snprintf(header, sizeof(header),
+        "HTTP/1.1 404 Error\r\n"
+        "Content-Type: text/html; charset=utf-8\r\n"
+        "Content-Length: %ld\r\n"
+        "Connection: close\r\n\r\n", size);
+
+    g_404 = malloc(hlen + size);
+    if (g_404) {
+        memcpy(g_404, header, hlen);
+        if (fread(g_404 + hlen, 1, size, f) == (size_t)size) {
+            g_404_len = hlen + size;
+        } else {
+            free(g_404);
+            g_404 = NULL;
+        }
+    }
+    fclose(f);
+}
+
+int negcache_init(const server_config_t *config) {
+    if (!config) return -1;
+
+    strncpy(g_doc_root, config->document_root, sizeof(g_doc_root) - 1);
+    g_doc_root_len = strlen(g_doc_root);
+    g_neg_ttl = config->negative_cache_ttl;
+    build_404();
+
+    if (!config->docroot_filter) return 0;
+
+    int fd = inotify_init1(IN_CLOEXEC);
+    bloom_t *b = bloom_build(fd);
+    if (!b) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    bloom_install(b);
+
+    // Sem inotify o filtro ficaria desatualizado: nesse caso não é usado
+    if (fd < 0 || pthread_create(&g_watch_thread, NULL, watch_thread_fn, (void*)(intptr_t)fd) != 0) {
+        if (fd >= 0) close(fd);
+        bloom_install(NULL);
+        return -1;
+    }
+    g_watch_started = 1;
+    g_filter = 1;
+    return 0;
+}
+
+// Só caminhos canónicos dentro da DOCUMENT_ROOT podem ser respondidos pelo filtro:
+// "a//b", "./" ou ".." podem chegar ao mesmo ficheiro por outro nome
+static int is_canonical(const char *path) {
+    if (strncmp(path, g_doc_root, g_doc_root_len) != 0 || path[g_doc_root_len] != '/') return 0;
+    const char *p = path + g_doc_root_len;
+    return !strstr(p, "//") && !strstr(p, "/./") && !strstr(p, "/../") &&
+           p[strlen(p) - 1] != '/' && p[strlen(p) - 1] != '.';
+}
+
+static inline uint64_t neg_tag(uint64_t hash) {
+    return hash & 0xFFFFFFFF00000000ULL;
+}
+
+int negcache_is_missing(const char *path) {
+    if (!path) return 0;
+    uint64_t hash = hash_path(path);
+
+    if (g_filter && is_canonical(path) && !__atomic_load_n(&g_bloom_stale, __ATOMIC_ACQUIRE)) {
+        // Anuncia a consulta antes de ler o ponteiro: o filtro não é libertado enquanto durar
+        if (tls_reader < 0) tls_reader = __sync_fetch_and_add(&g_next_reader, 1) % READER_SLOTS;
+        uint64_t *active = &g_readers[tls_reader].active;
+        __atomic_add_fetch(active, 1, __ATOMIC_SEQ_CST);
+        bloom_t *b = __atomic_load_n(&g_bloom, __ATOMIC_SEQ_CST);
+        int missing = b && !bloom_contains(b, hash);
+        __atomic_sub_fetch(active, 1, __ATOMIC_RELEASE);
+        if (missing) return 1;
+    }
+
+    if (g_neg_ttl <= 0) return 0;
+
+    uint64_t slot = __atomic_load_n(&g_neg[hash % NEG_SLOTS], __ATOMIC_RELAXED);
+    return slot && neg_tag(slot) == neg_tag(hash) &&
+           (uint32_t)slot > (uint32_t)time(NULL);
+}
+
+void negcache_add(const char *path) {
+    if (!path || g_neg_ttl <= 0) return;
+    uint64_t hash = hash_path(path);
+    uint32_t expires = (uint32_t)(time(NULL) + g_neg_ttl);
+    __atomic_store_n(&g_neg[hash % NEG_SLOTS], neg_tag(hash) | expires, __ATOMIC_RELAXED);
+}
+
+const char* negcache_404_response(const char *doc_root, size_t *len) {
+    if (!g_404 || !doc_root || strcmp(doc_root, g_doc_root) != 0) return NULL;
+    *len = g_404_len;
+    return g_404;
+}
+
+void negcache_cleanup(void) {
+    g_filter = 0;
+    if (g_watch_started) {
+        g_watch_stop = 1;
+        pthread_join(g_watch_thread, NULL);
+        g_watch_started = 0;
+    }
+    // As threads de pedidos já terminaram: nenhum leitor pode estar dentro de um filtro
+    bloom_install(NULL);
+    while (g_bloom_retired) {
+        bloom_t *next = g_bloom_retired->next;
+        bloom_free(g_bloom_retired);
+        g_bloom_retired = next;
+    }
+    free(g_walk_hashes);
+    g_walk_hashes = NULL;
+    g_walk_len = g_walk_cap = 0;
+    free(g_404);
+    g_404 = NULL;
+}
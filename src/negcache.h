@@ -0,0 +1,25 @@
+#ifndef NEGCACHE_H
+#define NEGCACHE_H
+
+#include <stddef.h>
+#include "config.h"
+
+// Filtro de existência para pedidos a ficheiros que não existem (scanners, 404 storms):
+//  - cache negativa: caminhos que falharam no fopen ficam marcados durante NEGATIVE_CACHE_TTL s
+//  - Bloom filter com todos os ficheiros da DOCUMENT_ROOT (reconstruído com inotify)
+//  - resposta 404 pré-construída, enviada sem abrir errors/404.html
+// Estado por processo: cada worker chama negcache_init depois do fork.
+int negcache_init(const server_config_t *config);
+
+// 1 se o caminho de certeza não existe (Bloom filter ou cache negativa)
+int negcache_is_missing(const char *path);
+
+// Regista um caminho que não existe
+void negcache_add(const char *path);
+
+// Resposta 404 completa (cabeçalhos + corpo) para a DOCUMENT_ROOT configurada, ou NULL
+const char* negcache_404_response(const char *doc_root, size_t *len);
+
+void negcache_cleanup(void);
+
+#endif
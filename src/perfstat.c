@@ -0,0 +1,186 @@
+#define _GNU_SOURCE
+#include "perfstat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <malloc.h>
+#include <linux/perf_event.h>
+
+enum { EV_CYCLES, EV_INSTRUCTIONS, EV_CACHE_MISSES, EV_SWITCHES, EV_COUNT };
+
+// Grupo de uma thread: fds[0] é o líder, "events" diz a que evento corresponde cada valor lido
+typedef struct {
+    int ready;             // Publicado pela thread depois de abrir tudo
+    int n;
+    int fds[EV_COUNT];
+    int events[EV_COUNT];
+} thread_perf_t;
+
+static thread_perf_t *g_threads = NULL;
+static int g_num_threads = 0;
+static int g_next_thread = 0;
+static int g_hw = 0;       // Alguma thread conseguiu abrir os ciclos
+
+// Só usados pela thread principal do worker
+static uint64_t g_prev_requests = 0;
+static proc_stats_t g_prev;
+static double g_ratios[4];
+
+static int open_event(uint32_t type, uint64_t config, int group_fd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_hv = 1;
+
+    // Só esta thread, em qualquer CPU
+    int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+    if (fd < 0 && (errno == EACCES || errno == EPERM)) {
+        // perf_event_paranoid >= 2: só o espaço do utilizador
+        attr.exclude_kernel = 1;
+        fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+    }
+    return fd;
+}
+
+static void add_event(thread_perf_t *t, int event, uint32_t type, uint64_t config) {
+    int fd = open_event(type, config, t->n ? t->fds[0] : -1);
+    if (fd < 0) return;
+    t->fds[t->n] = fd;
+    t->events[t->n] = event;
+    t->n++;
+}
+
+int perfstat_init(int perf_counters, int num_threads) {
+    memset(&g_prev, 0, sizeof(g_prev));
+    memset(g_ratios, 0, sizeof(g_ratios));
+    g_prev_requests = 0;
+    if (!perf_counters) return 0;
+    if (num_threads <= 0) return -1;
+    g_threads = calloc(num_threads, sizeof(thread_perf_t));
+    if (!g_threads) return -1;
+    g_num_threads = num_threads;
+    g_next_thread = 0;
+    return 0;
+}
+
+void perfstat_thread_start(void) {
+    if (!g_threads) return;
+    int idx = __sync_fetch_and_add(&g_next_thread, 1);
+    if (idx >= g_num_threads) return;
+    thread_perf_t *t = &g_threads[idx];
+
+    // Sem PMU (ex: VMs), o líder passa a ser o contador de software
+    add_event(t, EV_CYCLES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    if (t->n) {
+        __atomic_store_n(&g_hw, 1, __ATOMIC_RELAXED);
+        add_event(t, EV_INSTRUCTIONS, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        add_event(t, EV_CACHE_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    }
+    add_event(t, EV_SWITCHES, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES);
+    __atomic_store_n(&t->ready, 1, __ATOMIC_RELEASE);
+}
+
+// Soma os grupos de todas as threads (escalados se o kernel os multiplexou)
+static void read_threads(uint64_t totals[EV_COUNT]) {
+    memset(totals, 0, EV_COUNT * sizeof(uint64_t));
+    int active = __atomic_load_n(&g_next_thread, __ATOMIC_RELAXED);
+    if (active > g_num_threads) active = g_num_threads;
+
+    for (int i = 0; i < active; i++) {
+        thread_perf_t *t = &g_threads[i];
+        if (!__atomic_load_n(&t->ready, __ATOMIC_ACQUIRE) || t->n == 0) continue;
+
+        uint64_t buf[3 + EV_COUNT]; // nr, time_enabled, time_running, valores
+        ssize_t n = read(t->fds[0], buf, sizeof(buf));
+        if (n < (ssize_t)(3 * sizeof(uint64_t))) continue;
+        uint64_t nr = buf[0] < (uint64_t)t->n ? buf[0] : (uint64_t)t->n;
+        double scale = (buf[2] > 0 && buf[2] < buf[1]) ? (double)buf[1] / buf[2] : 1.0;
+        for (uint64_t k = 0; k < nr; k++) totals[t->events[k]] += (uint64_t)(buf[3 + k] * scale);
+    }
+}
+
+// RSS atual de /proc/self/statm; faults e trocas de contexto de todas as threads via getrusage
+static void read_proc(proc_stats_t *out) {
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f) {
+        unsigned long size, resident;
+        if (fscanf(f, "%lu %lu", &size, &resident) == 2) {
+            out->rss_bytes = (uint64_t)resident * (uint64_t)sysconf(_SC_PAGESIZE);
+        }
+        fclose(f);
+    }
+
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+        out->minor_faults = ru.ru_minflt;
+        out->major_faults = ru.ru_majflt;
+        out->voluntary_switches = ru.ru_nvcsw;
+        out->involuntary_switches = ru.ru_nivcsw;
+    }
+}
+
+// Com multiplexação a escala varia entre leituras: o total pode recuar um pouco
+static uint64_t delta(uint64_t now, uint64_t before) {
+    return now > before ? now - before : 0;
+}
+
+void perfstat_sample(uint64_t requests, proc_stats_t *out) {
+    memset(out, 0, sizeof(*out));
+    read_proc(out);
+
+    if (g_threads) {
+        uint64_t totals[EV_COUNT];
+        read_threads(totals);
+        out->perf_enabled = __atomic_load_n(&g_hw, __ATOMIC_RELAXED) ? 2 : 1;
+        out->cycles = totals[EV_CYCLES];
+        out->instructions = totals[EV_INSTRUCTIONS];
+        out->cache_misses = totals[EV_CACHE_MISSES];
+        out->context_switches = totals[EV_SWITCHES];
+    } else {
+        // Sem perf: as trocas de contexto por pedido vêm do getrusage
+        out->context_switches = out->voluntary_switches + out->involuntary_switches;
+    }
+
+    // Rácios do último segundo com pedidos (mantém os anteriores num segundo parado)
+    uint64_t reqs = requests - g_prev_requests;
+    if (reqs > 0) {
+        uint64_t cycles = delta(out->cycles, g_prev.cycles);
+        g_ratios[0] = (double)cycles / reqs;
+        g_ratios[1] = cycles ? (double)delta(out->instructions, g_prev.instructions) / cycles : 0;
+        g_ratios[2] = (double)delta(out->cache_misses, g_prev.cache_misses) / reqs;
+        g_ratios[3] = (double)delta(out->context_switches, g_prev.context_switches) / reqs;
+    }
+    out->cycles_per_request = g_ratios[0];
+    out->instructions_per_cycle = g_ratios[1];
+    out->cache_misses_per_request = g_ratios[2];
+    out->switches_per_request = g_ratios[3];
+
+    g_prev = *out;
+    g_prev_requests = requests;
+}
+
+void perfstat_heap(mem_stats_t *out) {
+    struct mallinfo2 mi = mallinfo2();
+    out->heap_arena = mi.arena;
+    out->heap_mmap = mi.hblkhd;
+    out->heap_in_use = mi.uordblks;
+    out->heap_free = mi.fordblks;
+}
+
+void perfstat_cleanup(void) {
+    if (!g_threads) return;
+    for (int i = 0; i < g_num_threads; i++) {
+        for (int k = 0; k < g_threads[i].n; k++) close(g_threads[i].fds[k]);
+    }
+    free(g_threads);
+    g_threads = NULL;
+    g_num_threads = 0;
+    g_hw = 0;
+}
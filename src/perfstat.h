@@ -0,0 +1,25 @@
+#ifndef PERFSTAT_H
+#define PERFSTAT_H
+
+#include <stdint.h>
+#include "stats.h"
+
+// Contadores do processo de cada worker: RSS, page faults e trocas de contexto (/proc/self e
+// getrusage, sempre) e, com PERF_COUNTERS=1, ciclos, instruções, cache misses e trocas de
+// contexto das threads dos pedidos via perf_event_open (um grupo por thread, lido pelo worker).
+// Estado por processo: cada worker chama perfstat_init depois do fork.
+int perfstat_init(int perf_counters, int num_threads);
+
+// Thread de pedidos, ao arrancar: abre os contadores desta thread (se ativos)
+void perfstat_thread_start(void);
+
+// Worker, 1x por segundo: lê tudo e calcula os rácios por pedido desde a última leitura.
+// "requests" é o total de pedidos servidos pelo worker.
+void perfstat_sample(uint64_t requests, proc_stats_t *out);
+
+// Estado das arenas do malloc (mallinfo2; percorre as arenas com os seus locks, não usar por pedido)
+void perfstat_heap(mem_stats_t *out);
+
+void perfstat_cleanup(void);
+
+#endif
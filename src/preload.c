@@ -0,0 +1,131 @@
+#define _GNU_SOURCE
+#include "preload.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ftw.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+typedef struct {
+    char *path;
+    size_t offset; // Posição dos dados na zona partilhada
+    size_t size;
+} preload_item_t;
+
+static preload_item_t *g_items = NULL;
+static int g_num_items = 0;
+static int g_cap_items = 0;
+static char *g_region = NULL;   // Todos os ficheiros, seguidos, numa única zona só de leitura
+static size_t g_region_size = 0;
+static size_t g_max_bytes = 0;
+static size_t g_total = 0;
+
+static int add_item(const char *path, size_t size) {
+    if (g_total + size > g_max_bytes) return 0; // Acima do limite: fica de fora
+    if (g_num_items == g_cap_items) {
+        int cap = g_cap_items ? g_cap_items * 2 : 64;
+        preload_item_t *items = realloc(g_items, cap * sizeof(preload_item_t));
+        if (!items) return -1;
+        g_items = items;
+        g_cap_items = cap;
+    }
+    g_items[g_num_items].path = strdup(path);
+    if (!g_items[g_num_items].path) return -1;
+    g_items[g_num_items].offset = g_total;
+    g_items[g_num_items].size = size;
+    g_num_items++;
+    g_total += size;
+    return 0;
+}
+
+static int walk_cb(const char *fpath, const struct stat *sb, int typeflag, struct FTW *ftwbuf) {
+    (void)ftwbuf;
+    if (typeflag == FTW_F && S_ISREG(sb->st_mode)) {
+        if (add_item(fpath, sb->st_size) < 0) return -1;
+    }
+    return 0;
+}
+
+static int cmp_items(const void *a, const void *b) {
+    return strcmp(((const preload_item_t*)a)->path, ((const preload_item_t*)b)->path);
+}
+
+int preload_init(const server_config_t *config) {
+    if (!config || !config->preload) return 0;
+    g_max_bytes = (size_t)config->preload_max_mb * 1024 * 1024;
+
+    // 1ª passagem: escolhe os ficheiros e calcula o tamanho total
+    if (config->preload_files[0]) {
+        char list[sizeof(config->preload_files)];
+        strncpy(list, config->preload_files, sizeof(list) - 1);
+        list[sizeof(list) - 1] = '\0';
+
+        char *save = NULL;
+        for (char *tok = strtok_r(list, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+            while (*tok == '/') tok++;
+            char path[1024];
+            struct stat st;
+            snprintf(path, sizeof(path), "%s/%s", config->document_root, tok);
+            if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+                fprintf(stderr, "[PRELOAD] Skipping %s (not a regular file)\n", path);
+                continue;
+            }
+            if (add_item(path, st.st_size) < 0) return -1;
+        }
+    } else if (nftw(config->document_root, walk_cb, 16, FTW_PHYS) != 0) {
+        return -1;
+    }
+
+    if (g_num_items == 0) return 0;
+
+    // 2ª passagem: lê tudo para uma zona anónima
+    g_region_size = g_total ? g_total : 1;
+    g_region = mmap(NULL, g_region_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (g_region == MAP_FAILED) {
+        g_region = NULL;
+        return -1;
+    }
+
+    int kept = 0;
+    for (int i = 0; i < g_num_items; i++) {
+        FILE *f = fopen(g_items[i].path, "rb");
+        if (f && fread(g_region + g_items[i].offset, 1, g_items[i].size, f) == g_items[i].size) {
+            g_items[kept++] = g_items[i];
+        } else {
+            free(g_items[i].path); // Ficheiro mudou ou desapareceu entre as passagens
+        }
+        if (f) fclose(f);
+    }
+    g_num_items = kept;
+
+    // A partir daqui ninguém escreve: as páginas ficam partilhadas entre todos os workers
+    mprotect(g_region, g_region_size, PROT_READ);
+    qsort(g_items, g_num_items, sizeof(preload_item_t), cmp_items);
+
+    printf("[PRELOAD] %d files (%.2f MB) loaded before fork\n", g_num_items, (double)g_total / (1024 * 1024));
+    fflush(stdout); // Antes do fork, senão cada worker herda o buffer e repete a linha
+    return 0;
+}
+
+int preload_lookup(const char *path, const void **data, size_t *size) {
+    if (!g_items || !path) return 0;
+
+    preload_item_t key = { .path = (char*)path };
+    preload_item_t *it = bsearch(&key, g_items, g_num_items, sizeof(preload_item_t), cmp_items);
+    if (!it) return 0;
+
+    *data = g_region + it->offset;
+    *size = it->size;
+    return 1;
+}
+
+void preload_cleanup(void) {
+    for (int i = 0; i < g_num_items; i++) free(g_items[i].path);
+    free(g_items);
+    if (g_region) munmap(g_region, g_region_size);
+    g_items = NULL;
+    g_region = NULL;
+    g_num_items = g_cap_items = 0;
+    g_total = 0;
+}
@@ -0,0 +1,17 @@
+#ifndef PRELOAD_H
+#define PRELOAD_H
+
+#include <stddef.h>
+#include "config.h"
+
+// Carrega para memória (antes do fork) os ficheiros de PRELOAD_FILES, ou toda a
+// DOCUMENT_ROOT até PRELOAD_MAX_MB. Os workers herdam as páginas em copy-on-write
+// e, como a zona fica só de leitura, nunca chegam a ser copiadas.
+int preload_init(const server_config_t *config);
+
+// Procura um caminho (no formato "<document_root>/<ficheiro>"). Devolve 1 se existir.
+int preload_lookup(const char *path, const void **data, size_t *size);
+
+void preload_cleanup(void);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+// Pontos de instrumentação estáticos (USDT) do provider "concurrent_http".
+// Com <sys/sdt.h> (pacote systemtap-sdt-dev) cada sonda é um único nop e uma nota no ELF:
+// não custa nada enquanto ninguém se ligar com bpftrace/perf. Com -DNO_USDT desaparecem
+// por completo, e o Makefile passa -DNO_USDT quando não encontra o cabeçalho.
+// Scripts de exemplo em tests/bpftrace/.
+#ifndef NO_USDT
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define HAVE_USDT 1
+#endif
+#endif
+#endif
+
+#ifdef HAVE_USDT
+#define PROBE1(name, a) DTRACE_PROBE1(concurrent_http, name, a)
+#define PROBE2(name, a, b) DTRACE_PROBE2(concurrent_http, name, a, b)
+#define PROBE3(name, a, b, c) DTRACE_PROBE3(concurrent_http, name, a, b, c)
+#define PROBE4(name, a, b, c, d) DTRACE_PROBE4(concurrent_http, name, a, b, c, d)
+#else
+#define PROBE1(name, a) do {} while (0)
+#define PROBE2(name, a, b) do {} while (0)
+#define PROBE3(name, a, b, c) do {} while (0)
+#define PROBE4(name, a, b, c, d) do {} while (0)
+#endif
+
+// conn_accept(fd, worker)
+#define PROBE_CONN_ACCEPT(fd, worker) PROBE2(conn_accept, fd, worker)
+// request_parsed(fd, method, path, host)
+#define PROBE_REQUEST_PARSED(fd, method, path, host) PROBE4(request_parsed, fd, method, path, host)
+// cache_hit(key, segment, size, l1): l1 = 1 se veio da cache local da thread
+#define PROBE_CACHE_HIT(key, segment, size, l1) PROBE4(cache_hit, key, segment, size, l1)
+// cache_miss(key, segment)
+#define PROBE_CACHE_MISS(key, segment) PROBE2(cache_miss, key, segment)
+// cache_evict(key, segment, size, reason): 0 capacidade, 1 desatualizada, 2 redimensionamento,
+// 3 rejeitada pelo TinyLFU, 4 destruição da cache
+#define PROBE_CACHE_EVICT(key, segment, size, reason) PROBE4(cache_evict, key, segment, size, reason)
+// file_open(path, err): err = 0 ou o errno do fopen
+#define PROBE_FILE_OPEN(path, err) PROBE2(file_open, path, err)
+// response_sent(fd, status, bytes, total_us)
+#define PROBE_RESPONSE_SENT(fd, status, bytes, total_us) PROBE4(response_sent, fd, status, bytes, total_us)
+// conn_close(fd, kept_open): kept_open = 1 se a conexão passou para o stream de /stats
+#define PROBE_CONN_CLOSE(fd, kept_open) PROBE2(conn_close, fd, kept_open)
+
+#endif
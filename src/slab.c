@@ -0,0 +1,278 @@
+#define _GNU_SOURCE
+#include "slab.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#define SLAB_PAGE_SIZE (64 * 1024)
+#define SLAB_HUGEPAGE_SIZE (2 * 1024 * 1024)
+#define SLAB_MIN_CHUNK 64
+#define SLAB_ALIGN 16
+#define SLAB_MAX_CLASSES 64
+// Acima disto o objeto usa páginas inteiras
+#define SLAB_MAX_SMALL (SLAB_PAGE_SIZE / 2)
+
+#define PAGE_FREE  -1  // Página livre
+#define PAGE_LARGE -2  // Primeira página de um objeto grande
+#define PAGE_CONT  -3  // Continuação de um objeto grande
+
+typedef struct {
+    int cls;           // Classe da página, ou PAGE_*
+    uint32_t npages;   // PAGE_LARGE: número de páginas do objeto
+    uint32_t used;     // Chunks ocupadas
+    uint32_t carved;   // Chunks já cortadas (corte preguiçoso)
+    void *free_list;   // Chunks devolvidas (lista ligada dentro das próprias chunks)
+    int prev, next;    // Lista de páginas parciais da classe
+} slab_page_t;
+
+struct slab_arena {
+    char *base;
+    size_t mapped;      // Tamanho do mmap
+    int num_pages;
+    int free_hint;      // Onde começar a procurar uma página livre
+    slab_page_t *pages;
+    int num_classes;
+    uint32_t class_size[SLAB_MAX_CLASSES];
+    int partial[SLAB_MAX_CLASSES]; // Primeira página com espaço de cada classe (-1 se nenhuma)
+    size_t used;
+    uint32_t *freeing;  // slab_fits_after_free: blocos a libertar em cada página (sempre a zeros fora dela)
+};
+
+static inline size_t align_up(size_t n, size_t a) { return (n + a - 1) & ~(a - 1); }
+
+// Classes crescem 25% de cada vez, alinhadas a 16 bytes
+static void init_classes(slab_arena_t *a) {
+    size_t size = SLAB_MIN_CHUNK;
+    a->num_classes = 0;
+    while (a->num_classes < SLAB_MAX_CLASSES) {
+        a->class_size[a->num_classes] = size;
+        a->partial[a->num_classes] = -1;
+        a->num_classes++;
+        if (size >= SLAB_MAX_SMALL) break;
+        size = align_up(size + size / 4, SLAB_ALIGN);
+        if (size > SLAB_MAX_SMALL) size = SLAB_MAX_SMALL;
+    }
+}
+
+static int class_for(slab_arena_t *a, size_t size) {
+    for (int c = 0; c < a->num_classes; c++) {
+        if (size <= a->class_size[c]) return c;
+    }
+    return -1;
+}
+
+slab_arena_t* slab_init(size_t bytes, int use_hugepages) {
+    slab_arena_t *a = calloc(1, sizeof(slab_arena_t));
+    if (!a) return NULL;
+
+    size_t granule = use_hugepages ? SLAB_HUGEPAGE_SIZE : SLAB_PAGE_SIZE;
+    a->mapped = align_up(bytes ? bytes : SLAB_PAGE_SIZE, granule);
+    a->base = MAP_FAILED;
+
+    if (use_hugepages) {
+        a->base = mmap(NULL, a->mapped, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (a->base == MAP_FAILED) {
+            fprintf(stderr, "[CACHE] Huge pages unavailable, using regular pages\n");
+        }
+    }
+    if (a->base == MAP_FAILED) {
+        a->base = mmap(NULL, a->mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (a->base == MAP_FAILED) {
+            free(a);
+            return NULL;
+        }
+        // Transparent huge pages se o kernel deixar
+        if (use_hugepages) madvise(a->base, a->mapped, MADV_HUGEPAGE);
+    }
+
+    a->num_pages = a->mapped / SLAB_PAGE_SIZE;
+    a->pages = malloc(a->num_pages * sizeof(slab_page_t));
+    a->freeing = calloc(a->num_pages, sizeof(uint32_t));
+    if (!a->pages || !a->freeing) {
+        free(a->pages);
+        free(a->freeing);
+        munmap(a->base, a->mapped);
+        free(a);
+        return NULL;
+    }
+    for (int i = 0; i < a->num_pages; i++) {
+        a->pages[i].cls = PAGE_FREE;
+        a->pages[i].prev = a->pages[i].next = -1;
+    }
+    init_classes(a);
+    return a;
+}
+
+static void partial_push(slab_arena_t *a, int cls, int p) {
+    a->pages[p].prev = -1;
+    a->pages[p].next = a->partial[cls];
+    if (a->partial[cls] >= 0) a->pages[a->partial[cls]].prev = p;
+    a->partial[cls] = p;
+}
+
+static void partial_remove(slab_arena_t *a, int cls, int p) {
+    slab_page_t *pg = &a->pages[p];
+    if (pg->prev >= 0) a->pages[pg->prev].next = pg->next; else a->partial[cls] = pg->next;
+    if (pg->next >= 0) a->pages[pg->next].prev = pg->prev;
+    pg->prev = pg->next = -1;
+}
+
+// Procura "n" páginas livres contíguas (first-fit a partir da dica). A segunda volta
+// passa a dica em n - 1 páginas para apanhar as sequências que a atravessam.
+static int find_free_run(slab_arena_t *a, int n) {
+    for (int pass = 0; pass < 2; pass++) {
+        int start = pass == 0 ? a->free_hint : 0;
+        int end = pass == 0 ? a->num_pages : a->free_hint + n - 1;
+        if (end > a->num_pages) end = a->num_pages;
+        int run = 0;
+        for (int i = start; i < end; i++) {
+            run = (a->pages[i].cls == PAGE_FREE) ? run + 1 : 0;
+            if (run == n) return i - n + 1;
+        }
+    }
+    return -1;
+}
+
+void* slab_alloc(slab_arena_t *a, size_t size) {
+    if (!a || size == 0) return NULL;
+
+    int cls = class_for(a, size);
+    if (cls < 0) {
+        // Objeto grande: páginas inteiras contíguas
+        int n = align_up(size, SLAB_PAGE_SIZE) / SLAB_PAGE_SIZE;
+        int p = find_free_run(a, n);
+        if (p < 0) return NULL;
+        a->pages[p].cls = PAGE_LARGE;
+        a->pages[p].npages = n;
+        for (int i = 1; i < n; i++) a->pages[p + i].cls = PAGE_CONT;
+        a->free_hint = (p + n) % a->num_pages;
+        a->used += (size_t)n * SLAB_PAGE_SIZE;
+        return a->base + (size_t)p * SLAB_PAGE_SIZE;
+    }
+
+    int p = a->partial[cls];
+    if (p < 0) {
+        // Nenhuma página com espaço nesta classe: atribui uma página livre
+        p = find_free_run(a, 1);
+        if (p < 0) return NULL;
+        slab_page_t *pg = &a->pages[p];
+        pg->cls = cls;
+        pg->used = 0;
+        pg->carved = 0;
+        pg->free_list = NULL;
+        partial_push(a, cls, p);
+        a->free_hint = (p + 1) % a->num_pages;
+    }
+
+    slab_page_t *pg = &a->pages[p];
+    uint32_t csize = a->class_size[cls];
+    void *chunk;
+    if (pg->free_list) {
+        chunk = pg->free_list;
+        pg->free_list = *(void**)chunk;
+    } else {
+        chunk = a->base + (size_t)p * SLAB_PAGE_SIZE + (size_t)pg->carved * csize;
+        pg->carved++;
+    }
+    pg->used++;
+    if (pg->used == SLAB_PAGE_SIZE / csize) partial_remove(a, cls, p);
+    a->used += csize;
+    return chunk;
+}
+
+void slab_free(slab_arena_t *a, void *ptr) {
+    if (!a || !ptr) return;
+
+    int p = ((char*)ptr - a->base) / SLAB_PAGE_SIZE;
+    slab_page_t *pg = &a->pages[p];
+
+    if (pg->cls == PAGE_LARGE) {
+        for (uint32_t i = 0; i < pg->npages; i++) a->pages[p + i].cls = PAGE_FREE;
+        a->used -= (size_t)pg->npages * SLAB_PAGE_SIZE;
+        return;
+    }
+
+    int cls = pg->cls;
+    uint32_t csize = a->class_size[cls];
+    if (pg->used == SLAB_PAGE_SIZE / csize) partial_push(a, cls, p);
+
+    *(void**)ptr = pg->free_list;
+    pg->free_list = ptr;
+    pg->used--;
+    a->used -= csize;
+
+    // Página vazia volta ao conjunto livre para poder mudar de classe
+    if (pg->used == 0) {
+        partial_remove(a, cls, p);
+        pg->cls = PAGE_FREE;
+    }
+}
+
+int slab_fits_after_free(slab_arena_t *a, size_t size, void *const *ptrs, int n) {
+    if (!a || size == 0) return 0;
+    int cls = class_for(a, size);
+    int need = cls < 0 ? (int)(align_up(size, SLAB_PAGE_SIZE) / SLAB_PAGE_SIZE) : 1;
+
+    int fits = 0;
+    for (int i = 0; i < n; i++) {
+        int p = ((char*)ptrs[i] - a->base) / SLAB_PAGE_SIZE;
+        // Uma chunk libertada da mesma classe basta a um objeto pequeno
+        if (cls >= 0 && a->pages[p].cls == cls) fits = 1;
+        a->freeing[p]++;
+    }
+
+    // Senão, "need" páginas contíguas livres ou que ficariam livres
+    int run = 0, large_left = 0;
+    for (int p = 0; p < a->num_pages && !fits; p++) {
+        slab_page_t *pg = &a->pages[p];
+        if (pg->cls == PAGE_LARGE) large_left = a->freeing[p] ? (int)pg->npages : 0;
+        int freed = pg->cls == PAGE_FREE || (pg->cls >= 0 && a->freeing[p] == pg->used) ||
+                    ((pg->cls == PAGE_LARGE || pg->cls == PAGE_CONT) && large_left > 0);
+        if (pg->cls == PAGE_LARGE || pg->cls == PAGE_CONT) large_left--;
+        run = freed ? run + 1 : 0;
+        if (run == need) fits = 1;
+    }
+
+    for (int i = 0; i < n; i++) a->freeing[((char*)ptrs[i] - a->base) / SLAB_PAGE_SIZE] = 0;
+    return fits;
+}
+
+size_t slab_chunk_size(slab_arena_t *a, size_t size) {
+    if (!a) return 0;
+    int cls = class_for(a, size);
+    if (cls >= 0) return a->class_size[cls];
+    size_t bytes = align_up(size, SLAB_PAGE_SIZE);
+    return bytes <= a->mapped ? bytes : 0;
+}
+
+void slab_trim(slab_arena_t *a) {
+    if (!a) return;
+    int run = 0;
+    for (int i = 0; i <= a->num_pages; i++) {
+        if (i < a->num_pages && a->pages[i].cls == PAGE_FREE) {
+            run++;
+        } else if (run > 0) {
+            // As páginas continuam mapeadas; voltam a zeros no próximo acesso
+            madvise(a->base + (size_t)(i - run) * SLAB_PAGE_SIZE, (size_t)run * SLAB_PAGE_SIZE, MADV_DONTNEED);
+            run = 0;
+        }
+    }
+}
+
+size_t slab_footprint(slab_arena_t *a) {
+    return a ? a->mapped + a->num_pages * (sizeof(slab_page_t) + sizeof(uint32_t)) + sizeof(*a) : 0;
+}
+
+size_t slab_used(slab_arena_t *a) {
+    return a ? a->used : 0;
+}
+
+void slab_destroy(slab_arena_t *a) {
+    if (!a) return;
+    munmap(a->base, a->mapped);
+    free(a->pages);
+    free(a->freeing);
+    free(a);
+}
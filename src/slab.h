@@ -0,0 +1,38 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+// Arena pré-alocada dividida em páginas. Objetos pequenos vêm de classes de tamanho
+// (várias chunks por página); objetos grandes ocupam páginas contíguas.
+// Não é thread-safe: quem usa (a cache) já o protege com o seu próprio lock.
+typedef struct slab_arena slab_arena_t;
+
+// Reserva "bytes" de memória (arredondado às páginas). use_hugepages tenta MAP_HUGETLB.
+slab_arena_t* slab_init(size_t bytes, int use_hugepages);
+
+// Devolve um bloco de pelo menos "size" bytes, ou NULL se a arena não tiver espaço
+void* slab_alloc(slab_arena_t *arena, size_t size);
+
+// Devolve o bloco à sua página
+void slab_free(slab_arena_t *arena, void *ptr);
+
+// 1 se, depois de libertar os "n" blocos de "ptrs", um pedido de "size" bytes seria servido.
+// Não altera a arena: permite decidir uma expulsão antes de a fazer.
+int slab_fits_after_free(slab_arena_t *a, size_t size, void *const *ptrs, int n);
+
+// Bytes realmente ocupados por um pedido de "size" bytes (0 se nunca caberia)
+size_t slab_chunk_size(slab_arena_t *arena, size_t size);
+
+// Devolve ao kernel as páginas livres (MADV_DONTNEED), p.ex. depois de encolher a cache
+void slab_trim(slab_arena_t *arena);
+
+// Memória total reservada (dados + descritores das páginas)
+size_t slab_footprint(slab_arena_t *arena);
+
+// Bytes atualmente atribuídos a blocos
+size_t slab_used(slab_arena_t *arena);
+
+void slab_destroy(slab_arena_t *arena);
+
+#endif
@@ -1,76 +1,562 @@
 #define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE // struct tcp_info
 #include "master.h"
 #include <stdio.h>
-#include <semaphore.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sched.h>
+
+// Slot da thread atual (NULL fora das threads dos workers)
+static __thread stats_slot_t *tls_slot = NULL;
+static __thread int tls_worker = -1;
+static int g_next_thread = 0; // Próximo slot livre deste worker (por processo)
+
+// Definido aqui e não no memstat.c: quem só lê as estatísticas (httptop) não leva os wrappers do malloc
+__thread alloc_counter_t memstat_thread_allocs;
+
+void stats_bind_thread(ipc_handles_t *handles, int worker_id) {
+    if (!handles || !handles->shared_data || worker_id < 0 || worker_id >= MAX_WORKERS) return;
+    int per_worker = handles->shared_data->threads_per_worker;
+    int t = __sync_fetch_and_add(&g_next_thread, 1);
+    if (t >= per_worker) return;
+    tls_slot = &handles->shared_data->slots[worker_id * per_worker + t];
+    tls_worker = worker_id;
+}
 
 void stats_update(ipc_handles_t *handles, int status_code, uint64_t bytes) {
-    if (!handles || !handles->shared_data) return;
-    // Entra na secção critica
-    sem_wait(handles->sem_stats);
+    (void)handles;
+    stats_slot_t *s = tls_slot;
+    if (!s) return;
 
-    server_stats_t *stats = &handles->shared_data->stats;
-    stats->total_requests++;
-    stats->bytes_transferred += bytes;
+    seq_write_begin(&s->seq);
+    s->requests++;
+    s->bytes += bytes;
 
+    int cls = status_code / 100;
+    s->status_class[(cls > 0 && cls < STATUS_CLASSES) ? cls : 0]++;
     switch (status_code) {
-        case 200: stats->status_200++; break;
-        case 403: stats->status_403++; break;
-        case 404: stats->status_404++; break;
-        case 500: stats->status_500++; break;
-        case 503: stats->status_503++; break;
+        case 200: s->status_200++; break;
+        case 403: s->status_403++; break;
+        case 404: s->status_404++; break;
+        case 500: s->status_500++; break;
+        case 503: s->status_503++; break;
+    }
+    seq_write_end(&s->seq);
+}
+
+// Só chamado acima do limite: o caminho rápido não paga nada além da comparação
+static void record_slow(ipc_handles_t *handles, const request_timing_t *t, uint64_t total_us, uint64_t cpu_us, uint64_t allocs) {
+    worker_stats_t *w = &handles->shared_data->workers[tls_worker];
+    uint32_t ticket = __atomic_fetch_add(&w->slow_next, 1, __ATOMIC_RELAXED);
+    slow_entry_t *e = &w->slow[ticket % SLOW_RING_SIZE];
+
+    __atomic_store_n(&e->seq, ticket * 2 + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    e->worker = tls_worker;
+    e->when = time(NULL);
+    e->total_us = total_us > UINT32_MAX ? UINT32_MAX : (uint32_t)total_us;
+    e->cpu_us = cpu_us > UINT32_MAX ? UINT32_MAX : (uint32_t)cpu_us;
+    e->allocs = allocs > UINT32_MAX ? UINT32_MAX : (uint32_t)allocs;
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        e->stage_us[i] = t->stage_us[i] > UINT32_MAX ? UINT32_MAX : (uint32_t)t->stage_us[i];
     }
+    e->bytes = t->bytes;
+    e->status = t->status;
+    e->cache_hit = t->cache_hit;
+    snprintf(e->vhost, sizeof(e->vhost), "%s", t->vhost ? t->vhost : "");
+    snprintf(e->path, sizeof(e->path), "%s", t->path ? t->path : "");
 
-    // Sai da secção crítica
-    sem_post(handles->sem_stats);
+    // Endereço do cliente só aqui (getpeername é uma syscall)
+    struct sockaddr_storage addr;
+    socklen_t alen = sizeof(addr);
+    char host[INET6_ADDRSTRLEN] = "?";
+    int port = 0;
+    if (t->client_fd >= 0 && getpeername(t->client_fd, (struct sockaddr*)&addr, &alen) == 0) {
+        if (addr.ss_family == AF_INET) {
+            struct sockaddr_in *in = (struct sockaddr_in*)&addr;
+            inet_ntop(AF_INET, &in->sin_addr, host, sizeof(host));
+            port = ntohs(in->sin_port);
+        } else if (addr.ss_family == AF_INET6) {
+            struct sockaddr_in6 *in6 = (struct sockaddr_in6*)&addr;
+            inet_ntop(AF_INET6, &in6->sin6_addr, host, sizeof(host));
+            port = ntohs(in6->sin6_port);
+        }
+    }
+    snprintf(e->client, sizeof(e->client), "%s:%d", host, port);
+    __atomic_store_n(&e->seq, ticket * 2 + 2, __ATOMIC_RELEASE);
 }
-void stats_record_response_time(ipc_handles_t *handles, struct timespec *start_time) {
-    if (!handles || !handles->shared_data || !start_time) return;
 
-    struct timespec end_time;
+void stats_record_request(ipc_handles_t *handles, const request_timing_t *timing) {
+    stats_slot_t *s = tls_slot;
+    if (!s || !timing) return;
+
+    struct timespec end_time, cpu_end;
     clock_gettime(CLOCK_MONOTONIC, &end_time);
-    
-    uint64_t elapsed_ms = (end_time.tv_sec - start_time->tv_sec) * 1000 +(end_time.tv_nsec - start_time->tv_nsec) / 1000000;
-    
-    // Protege a escrita do tempo total
-    sem_wait(handles->sem_stats);
-    handles->shared_data->stats.total_response_time_ms += elapsed_ms;
-    sem_post(handles->sem_stats);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+    uint64_t total_us = timespec_diff_us(&timing->start, &end_time);
+    uint64_t cpu_us = timespec_diff_us(&timing->cpu_start, &cpu_end);
+    uint64_t allocs = memstat_thread_allocs.count - timing->allocs_start.count;
+
+    seq_write_begin(&s->seq);
+    hist_record(&s->latency, total_us);
+    hist_record(&s->cpu, cpu_us);
+    s->allocs += allocs;
+    s->alloc_bytes += memstat_thread_allocs.bytes - timing->allocs_start.bytes;
+    if (allocs > s->allocs_max) s->allocs_max = allocs;
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        if (timing->touched & (1u << i)) hist_record(&s->stages[i], timing->stage_us[i]);
+    }
+    seq_write_end(&s->seq);
+
+    uint32_t slow_us = handles->shared_data->slow_us;
+    if (slow_us && total_us >= slow_us) record_slow(handles, timing, total_us, cpu_us, allocs);
 }
 
 void stats_inc_active(ipc_handles_t *handles) {
+    (void)handles;
+    stats_slot_t *s = tls_slot;
+    if (!s) return;
+    seq_write_begin(&s->seq);
+    s->opened++;
+    seq_write_end(&s->seq);
+}
+
+void stats_dec_active(ipc_handles_t *handles) {
+    (void)handles;
+    stats_slot_t *s = tls_slot;
+    if (!s) return;
+    seq_write_begin(&s->seq);
+    s->closed++;
+    seq_write_end(&s->seq);
+}
+
+void stats_publish_cache(ipc_handles_t *handles, int worker_id, const cache_stats_t *cache) {
+    if (!handles || !handles->shared_data || worker_id < 0 || worker_id >= MAX_WORKERS) return;
+    worker_stats_t *w = &handles->shared_data->workers[worker_id];
+    seq_write_begin(&w->seq);
+    w->cache = *cache;
+    seq_write_end(&w->seq);
+}
+
+void stats_publish_top(ipc_handles_t *handles, int worker_id, const path_rate_t *hits, const path_rate_t *bytes) {
+    if (!handles || !handles->shared_data || worker_id < 0 || worker_id >= MAX_WORKERS) return;
+    worker_stats_t *w = &handles->shared_data->workers[worker_id];
+    seq_write_begin(&w->top_seq);
+    memcpy(w->top_hits, hits, sizeof(w->top_hits));
+    memcpy(w->top_bytes, bytes, sizeof(w->top_bytes));
+    seq_write_end(&w->top_seq);
+}
+
+void stats_record_tcp(ipc_handles_t *handles, int vhost, const tcp_sample_t *sample) {
+    if (!handles || !handles->shared_data || tls_worker < 0 || vhost < 0 || vhost >= VHOST_COUNT) return;
+    worker_stats_t *w = &handles->shared_data->workers[tls_worker];
+
+    // Várias threads do worker escrevem aqui, mas raramente: um spinlock chega para o seqlock
+    while (__atomic_exchange_n(&w->tcp_lock, 1, __ATOMIC_ACQUIRE)) sched_yield();
+    seq_write_begin(&w->tcp_seq);
+    tcp_stats_t *t = &w->tcp[vhost];
+    t->samples++;
+    t->retransmits += sample->retransmits;
+    if (sample->retransmits) t->retransmitted++;
+    if (sample->unacked) t->unacked++;
+    t->bytes_acked += sample->bytes_acked;
+    t->cwnd_sum += sample->cwnd;
+    t->rttvar_sum += sample->rttvar_us;
+    hist_record(&t->rtt, sample->rtt_us);
+    hist_record(&t->delivery, sample->delivery_rate / 1024);
+    seq_write_end(&w->tcp_seq);
+    __atomic_store_n(&w->tcp_lock, 0, __ATOMIC_RELEASE);
+}
+
+void stats_publish_proc(ipc_handles_t *handles, int worker_id, const proc_stats_t *proc, const mem_stats_t *mem) {
+    if (!handles || !handles->shared_data || worker_id < 0 || worker_id >= MAX_WORKERS) return;
+    worker_stats_t *w = &handles->shared_data->workers[worker_id];
+    seq_write_begin(&w->proc_seq);
+    w->proc = *proc;
+    w->mem = *mem;
+    seq_write_end(&w->proc_seq);
+}
+
+uint64_t stats_worker_requests(ipc_handles_t *handles, int worker_id) {
+    if (!handles || !handles->shared_data || worker_id < 0 || worker_id >= MAX_WORKERS) return 0;
+    shared_data_t *shm = handles->shared_data;
+    uint64_t total = 0;
+    // Um contador de 64 bits alinhado lê-se inteiro: não precisa da cópia do seqlock
+    for (int t = 0; t < shm->threads_per_worker; t++) {
+        total += __atomic_load_n(&shm->slots[worker_id * shm->threads_per_worker + t].requests, __ATOMIC_RELAXED);
+    }
+    return total;
+}
+
+uint32_t stats_worker_active(ipc_handles_t *handles, int worker_id) {
+    if (!handles || !handles->shared_data || worker_id < 0 || worker_id >= MAX_WORKERS) return 0;
+    shared_data_t *shm = handles->shared_data;
+    uint64_t opened = 0, closed = 0;
+    for (int t = 0; t < shm->threads_per_worker; t++) {
+        stats_slot_t *slot = &shm->slots[worker_id * shm->threads_per_worker + t];
+        opened += __atomic_load_n(&slot->opened, __ATOMIC_RELAXED);
+        closed += __atomic_load_n(&slot->closed, __ATOMIC_RELAXED);
+    }
+    return opened > closed ? (uint32_t)(opened - closed) : 0;
+}
+
+void stats_snapshot(ipc_handles_t *handles, server_stats_t *out) {
+    memset(out, 0, sizeof(*out));
     if (!handles || !handles->shared_data) return;
+    shared_data_t *shm = handles->shared_data;
+    out->start_time = shm->start_time;
+
+    uint64_t opened = 0, closed = 0;
+    for (int w = 0; w < shm->num_workers && w < MAX_WORKERS; w++) {
+        for (int t = 0; t < shm->threads_per_worker; t++) {
+            stats_slot_t *slot = &shm->slots[w * shm->threads_per_worker + t];
+            stats_slot_t s;
+            seq_read(&slot->seq, &s, slot, sizeof(s));
 
-    // Protege o contador de conexões ativas
-    sem_wait(handles->sem_stats);
-    handles->shared_data->stats.active_connections++;
-    sem_post(handles->sem_stats);
+            out->total_requests += s.requests;
+            out->bytes_transferred += s.bytes;
+            hist_merge(&out->latency, &s.latency);
+            hist_merge(&out->cpu, &s.cpu);
+            for (int i = 0; i < STAGE_COUNT; i++) hist_merge(&out->stages[i], &s.stages[i]);
+            out->request_allocs += s.allocs;
+            out->request_alloc_bytes += s.alloc_bytes;
+            if (s.allocs_max > out->request_allocs_max) out->request_allocs_max = s.allocs_max;
+            for (int c = 0; c < STATUS_CLASSES; c++) out->status_class[c] += s.status_class[c];
+            out->status_200 += s.status_200;
+            out->status_403 += s.status_403;
+            out->status_404 += s.status_404;
+            out->status_500 += s.status_500;
+            out->status_503 += s.status_503;
+            opened += s.opened;
+            closed += s.closed;
+        }
+    }
+    out->active_connections = opened > closed ? opened - closed : 0;
+    seq_read(&shm->window_seq, &out->latency_window, &shm->latency_window, sizeof(hist_t));
 }
 
-void stats_dec_active(ipc_handles_t *handles) {
+// Quem responde a pedidos não percorre os slots: copia a fotografia que o master já fez
+void stats_published(ipc_handles_t *handles, server_stats_t *out) {
+    if (!handles || !handles->shared_data) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    shared_data_t *shm = handles->shared_data;
+    if (__atomic_load_n(&shm->snapshot_seq, __ATOMIC_ACQUIRE) == 0) {
+        stats_snapshot(handles, out); // Antes do primeiro segundo
+        return;
+    }
+    seq_read(&shm->snapshot_seq, out, &shm->snapshot, sizeof(*out));
+
+    // Só dois contadores por slot: barato, e o valor não fica um segundo atrasado
+    uint32_t active = 0;
+    for (int w = 0; w < shm->num_workers && w < MAX_WORKERS; w++) active += stats_worker_active(handles, w);
+    out->active_connections = active;
+}
+
+// Fotografias cumulativas de cada segundo (só no master)
+static hist_t g_window_ring[STATS_WINDOW_SECONDS + 1];
+static int g_window_pos = 0;
+static second_stats_t g_prev_totals; // Contadores na fotografia anterior
+
+// Um worker substituído recomeça do zero: nesse segundo o total pode recuar
+static uint64_t counter_delta(uint64_t now, uint64_t before) {
+    return now > before ? now - before : 0;
+}
+
+void stats_tick(ipc_handles_t *handles) {
     if (!handles || !handles->shared_data) return;
 
-    // Protege o contador de conexões ativas
-    sem_wait(handles->sem_stats);
-    if (handles->shared_data->stats.active_connections > 0)
-        handles->shared_data->stats.active_connections--;
-    sem_post(handles->sem_stats);
+    server_stats_t now;
+    stats_snapshot(handles, &now);
+
+    // A janela é a diferença entre agora e a fotografia mais antiga do anel
+    hist_t *previous = &g_window_ring[g_window_pos];
+    g_window_pos = (g_window_pos + 1) % (STATS_WINDOW_SECONDS + 1);
+    hist_t *oldest = &g_window_ring[(g_window_pos + 1) % (STATS_WINDOW_SECONDS + 1)];
+
+    // Segundo que acabou: diferença para a fotografia anterior, com a latência agrupada
+    second_stats_t sec;
+    memset(&sec, 0, sizeof(sec));
+    sec.second = time(NULL);
+    sec.requests = counter_delta(now.total_requests, g_prev_totals.requests);
+    sec.bytes = counter_delta(now.bytes_transferred, g_prev_totals.bytes);
+    for (int c = 0; c < STATUS_CLASSES; c++) {
+        sec.status_class[c] = counter_delta(now.status_class[c], g_prev_totals.status_class[c]);
+        g_prev_totals.status_class[c] = now.status_class[c];
+    }
+    g_prev_totals.requests = now.total_requests;
+    g_prev_totals.bytes = now.bytes_transferred;
+
+    hist_t last;
+    hist_diff(&last, &now.latency, previous);
+    static const uint64_t bounds[RATE_BUCKETS - 1] = RATE_BOUNDS_US;
+    uint64_t below = 0;
+    for (int b = 0; b < RATE_BUCKETS - 1; b++) {
+        uint64_t le = hist_count_le(&last, bounds[b]);
+        sec.latency[b] = counter_delta(le, below);
+        below = le;
+    }
+    sec.latency[RATE_BUCKETS - 1] = counter_delta(last.count, below);
+
+    g_window_ring[g_window_pos] = now.latency;
+    hist_t window;
+    hist_diff(&window, &now.latency, oldest);
+    shared_data_t *shm = handles->shared_data;
+    seq_write_begin(&shm->window_seq);
+    shm->latency_window = window;
+    seq_write_end(&shm->window_seq);
+
+    now.latency_window = window;
+    seq_write_begin(&shm->snapshot_seq);
+    shm->snapshot = now;
+    seq_write_end(&shm->snapshot_seq);
+
+    seq_write_begin(&shm->history_seq);
+    shm->history_pos = (shm->history_pos + 1) % STATS_HISTORY_SECONDS;
+    shm->history[shm->history_pos] = sec;
+    seq_write_end(&shm->history_seq);
 }
 
+int stats_history(ipc_handles_t *handles, second_stats_t *out, int max) {
+    if (!handles || !handles->shared_data || max <= 0) return 0;
+    if (max > STATS_HISTORY_SECONDS) max = STATS_HISTORY_SECONDS;
+    shared_data_t *shm = handles->shared_data;
 
-void stats_display(ipc_handles_t *handles) {
+    // Só copia os segundos pedidos (o anel inteiro tem STATS_HISTORY_SECONDS entradas)
+    int n = 0;
+    for (int tries = 0; ; tries++) {
+        uint32_t before = __atomic_load_n(&shm->history_seq, __ATOMIC_ACQUIRE);
+        uint32_t pos = shm->history_pos % STATS_HISTORY_SECONDS;
+        for (n = 0; n < max; n++) {
+            const second_stats_t *e = &shm->history[(pos + STATS_HISTORY_SECONDS - n) % STATS_HISTORY_SECONDS];
+            if (e->second == 0) break;
+            out[n] = *e;
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if ((!(before & 1) && __atomic_load_n(&shm->history_seq, __ATOMIC_RELAXED) == before) || tries >= SEQ_MAX_RETRIES) break;
+    }
+    return n;
+}
+
+void stats_rates(ipc_handles_t *handles, int seconds, rate_stats_t *out) {
+    memset(out, 0, sizeof(*out));
+    if (!handles || !handles->shared_data) return;
+    if (seconds < 1) seconds = 1;
+    if (seconds > STATS_HISTORY_SECONDS) seconds = STATS_HISTORY_SECONDS;
+
+    second_stats_t history[STATS_HISTORY_SECONDS];
+    int n = stats_history(handles, history, seconds);
+    if (n == 0) return;
+
+    // Segundos em que o master não correu contam como zero; logo após o arranque a janela é a do uptime
+    time_t newest = history[0].second;
+    long span = (long)(newest - handles->shared_data->start_time);
+    out->seconds = span < 1 ? 1 : (span < seconds ? (int)span : seconds);
+    for (int k = 0; k < n && history[k].second > newest - seconds; k++) {
+        out->requests += history[k].requests;
+        out->bytes += history[k].bytes;
+        for (int c = 0; c < STATUS_CLASSES; c++) out->status_class[c] += history[k].status_class[c];
+        for (int b = 0; b < RATE_BUCKETS; b++) out->latency[b] += history[k].latency[b];
+    }
+    out->requests /= out->seconds;
+    out->bytes /= out->seconds;
+    for (int c = 0; c < STATUS_CLASSES; c++) out->status_class[c] /= out->seconds;
+}
+
+void stats_sample_queue(ipc_handles_t *handles, int listen_fd) {
+    if (!handles || !handles->shared_data || listen_fd < 0) return;
+    // Num socket em LISTEN, tcpi_unacked é a fila de accept atual e tcpi_sacked o backlog
+    struct tcp_info info;
+    socklen_t len = sizeof(info);
+    if (getsockopt(listen_fd, IPPROTO_TCP, TCP_INFO, &info, &len) != 0) return;
+    __atomic_store_n(&handles->shared_data->accept_queue, info.tcpi_unacked, __ATOMIC_RELAXED);
+    __atomic_store_n(&handles->shared_data->accept_backlog, info.tcpi_sacked, __ATOMIC_RELAXED);
+}
+
+void stats_worker_cache(ipc_handles_t *handles, int worker_id, cache_stats_t *out) {
+    memset(out, 0, sizeof(*out));
+    if (!handles || !handles->shared_data || worker_id < 0 || worker_id >= MAX_WORKERS) return;
+    worker_stats_t *w = &handles->shared_data->workers[worker_id];
+    seq_read(&w->seq, out, &w->cache, sizeof(*out));
+}
+
+void stats_worker_proc(ipc_handles_t *handles, int worker_id, proc_stats_t *out) {
+    memset(out, 0, sizeof(*out));
+    if (!handles || !handles->shared_data || worker_id < 0 || worker_id >= MAX_WORKERS) return;
+    worker_stats_t *w = &handles->shared_data->workers[worker_id];
+    seq_read(&w->proc_seq, out, &w->proc, sizeof(*out));
+}
+
+void stats_worker_mem(ipc_handles_t *handles, int worker_id, mem_stats_t *out) {
+    memset(out, 0, sizeof(*out));
+    if (!handles || !handles->shared_data || worker_id < 0 || worker_id >= MAX_WORKERS) return;
+    worker_stats_t *w = &handles->shared_data->workers[worker_id];
+    seq_read(&w->proc_seq, out, &w->mem, sizeof(*out));
+}
+
+void stats_tcp(ipc_handles_t *handles, int vhost, tcp_stats_t *out) {
+    memset(out, 0, sizeof(*out));
+    if (!handles || !handles->shared_data || vhost < 0 || vhost >= VHOST_COUNT) return;
+    for (int i = 0; i < handles->shared_data->num_workers && i < MAX_WORKERS; i++) {
+        worker_stats_t *w = &handles->shared_data->workers[i];
+        tcp_stats_t t;
+        seq_read(&w->tcp_seq, &t, &w->tcp[vhost], sizeof(t));
+        out->samples += t.samples;
+        out->retransmits += t.retransmits;
+        out->retransmitted += t.retransmitted;
+        out->unacked += t.unacked;
+        out->bytes_acked += t.bytes_acked;
+        out->cwnd_sum += t.cwnd_sum;
+        out->rttvar_sum += t.rttvar_sum;
+        hist_merge(&out->rtt, &t.rtt);
+        hist_merge(&out->delivery, &t.delivery);
+    }
+}
+
+void stats_cache_totals(ipc_handles_t *handles, cache_stats_t *total) {
+    memset(total, 0, sizeof(*total));
+    if (!handles || !handles->shared_data) return;
+
+    for (int i = 0; i < handles->shared_data->num_workers && i < MAX_WORKERS; i++) {
+        cache_stats_t c;
+        stats_worker_cache(handles, i, &c);
+        total->hits += c.hits;
+        total->l1_hits += c.l1_hits;
+        total->misses += c.misses;
+        total->evictions_capacity += c.evictions_capacity;
+        total->evictions_stale += c.evictions_stale;
+        total->evictions_resize += c.evictions_resize;
+        total->admission_rejects += c.admission_rejects;
+        total->size_rejects += c.size_rejects;
+        total->fills += c.fills;
+        total->fill_time_us += c.fill_time_us;
+        total->bytes_used += c.bytes_used;
+        total->bytes_budget += c.bytes_budget;
+        total->entries += c.entries;
+    }
+}
+
+void stats_top_paths(ipc_handles_t *handles, int by_bytes, path_rate_t *out) {
+    memset(out, 0, TOPN_PUBLISH * sizeof(path_rate_t));
     if (!handles || !handles->shared_data) return;
 
-    // Bloqueia para garantir que a leitura de todas as stats é consistente
-    sem_wait(handles->sem_stats);
+    // Soma o mesmo caminho em todos os workers e fica com os maiores
+    int workers = handles->shared_data->num_workers < MAX_WORKERS ? handles->shared_data->num_workers : MAX_WORKERS;
+    path_rate_t *all = malloc((size_t)(workers > 0 ? workers : 1) * TOPN_PUBLISH * sizeof(path_rate_t));
+    if (!all) return;
+    int n = 0;
+    for (int i = 0; i < workers; i++) {
+        worker_stats_t *w = &handles->shared_data->workers[i];
+        path_rate_t top[TOPN_PUBLISH];
+        seq_read(&w->top_seq, top, by_bytes ? w->top_bytes : w->top_hits, sizeof(top));
+        for (int k = 0; k < TOPN_PUBLISH && top[k].path[0]; k++) {
+            top[k].path[TOPN_PATH_MAX - 1] = '\0';
+            int j = 0;
+            while (j < n && strcmp(all[j].path, top[k].path) != 0) j++;
+            if (j == n) all[n++] = top[k];
+            else all[j].rate += top[k].rate;
+        }
+    }
+
+    for (int k = 0; k < TOPN_PUBLISH; k++) {
+        int best = -1;
+        for (int j = 0; j < n; j++) {
+            if (all[j].path[0] && (best < 0 || all[j].rate > all[best].rate)) best = j;
+        }
+        if (best < 0) break;
+        out[k] = all[best];
+        all[best].path[0] = '\0';
+    }
+    free(all);
+}
 
-    server_stats_t *stats = &handles->shared_data->stats;
+int stats_slow_requests(ipc_handles_t *handles, slow_entry_t *out, int max) {
+    if (!handles || !handles->shared_data || max <= 0) return 0;
+    int n = 0;
+    for (int i = 0; i < handles->shared_data->num_workers && i < MAX_WORKERS; i++) {
+        worker_stats_t *w = &handles->shared_data->workers[i];
+        for (int k = 0; k < SLOW_RING_SIZE; k++) {
+            slow_entry_t *e = &w->slow[k];
+            uint32_t before = __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE);
+            if (before == 0 || (before & 1)) continue; // Vazia ou a ser escrita
+            slow_entry_t copy = *e;
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&e->seq, __ATOMIC_RELAXED) != before) continue;
+            copy.path[sizeof(copy.path) - 1] = copy.vhost[sizeof(copy.vhost) - 1] = copy.client[sizeof(copy.client) - 1] = '\0';
+
+            // Inserção ordenada (mais recente primeiro); com o vetor cheio sai a mais antiga
+            int pos = n < max ? n : max;
+            while (pos > 0 && out[pos - 1].when < copy.when) {
+                if (pos < max) out[pos] = out[pos - 1];
+                pos--;
+            }
+            if (pos < max) {
+                out[pos] = copy;
+                if (n < max) n++;
+            }
+        }
+    }
+    return n;
+}
+
+int stats_format_slow(const slow_entry_t *e, char *buf, size_t len) {
+    static const char *stage_names[] = STAGE_NAMES;
+    struct tm tm;
+    char when[32];
+    localtime_r(&e->when, &tm);
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+
+    int off = snprintf(buf, len, "%s worker=%d %.1fms cpu=%.1fms %u %s %luB allocs=%u client=%s host=%s %s |",
+                       when, e->worker, e->total_us / 1000.0, e->cpu_us / 1000.0, e->status,
+                       e->cache_hit ? "HIT" : "MISS", e->bytes, e->allocs, e->client, e->vhost[0] ? e->vhost : "-", e->path);
+    for (int i = 0; i < STAGE_COUNT && off > 0 && (size_t)off < len; i++) {
+        off += snprintf(buf + off, len - off, " %s=%.1f", stage_names[i], e->stage_us[i] / 1000.0);
+    }
+    return off;
+}
+
+void stats_dump_slow(ipc_handles_t *handles) {
+    slow_entry_t *entries = malloc(MAX_WORKERS * SLOW_RING_SIZE * sizeof(slow_entry_t));
+    if (!entries) return;
+    int n = stats_slow_requests(handles, entries, MAX_WORKERS * SLOW_RING_SIZE);
+    printf("\n========================================\n");
+    printf("SLOW REQUESTS (%d, newest first, stages in ms)\n", n);
+    printf("========================================\n");
+    for (int i = 0; i < n; i++) {
+        char line[512];
+        stats_format_slow(&entries[i], line, sizeof(line));
+        printf("%s\n", line);
+    }
+    printf("========================================\n\n");
+    fflush(stdout);
+    free(entries);
+}
+
+static void print_latency(const char *label, const hist_t *h) {
+    printf("%s (us): p50=%lu p90=%lu p99=%lu p99.9=%lu max=%lu\n", label,
+           hist_percentile(h, 50), hist_percentile(h, 90), hist_percentile(h, 99),
+           hist_percentile(h, 99.9), h->max_us);
+}
+
+void stats_display(ipc_handles_t *handles) {
+    if (!handles || !handles->shared_data) return;
+
+    // Fotografia consistente de todos os slots (sem bloquear os workers)
+    server_stats_t snapshot;
+    stats_snapshot(handles, &snapshot);
+    server_stats_t *stats = &snapshot;
     time_t uptime = time(NULL) - stats->start_time;
 
-    uint64_t avg_response_time_ms = 0;
-    if (stats->total_requests > 0) {
+    double avg_response_time_ms = 0;
+    if (stats->latency.count > 0) {
         // Cálculo da média
-        avg_response_time_ms = stats->total_response_time_ms / stats->total_requests;
+        avg_response_time_ms = stats->latency.sum_us / 1000.0 / stats->latency.count;
     }
 
     // Formata e imprime o relatório (simplesmente para consola do Master)
@@ -79,15 +565,100 @@ void stats_display(ipc_handles_t *handles) {
     printf("========================================\n");
     printf("Uptime: %ld seconds\n", uptime);
     printf("Total Requests: %lu\n", stats->total_requests);
-    printf("Successful (200): %u\n", stats->status_200);
-    printf("Forbidden (403): %u\n", stats->status_403);
-    printf("Not Found (404): %u\n", stats->status_404);
-    printf("Server Error (500): %u\n", stats->status_500);
-    printf("Service Unavailable (503): %u\n", stats->status_503);
+    printf("Successful (200): %lu\n", stats->status_200);
+    printf("Forbidden (403): %lu\n", stats->status_403);
+    printf("Not Found (404): %lu\n", stats->status_404);
+    printf("Server Error (500): %lu\n", stats->status_500);
+    printf("Service Unavailable (503): %lu\n", stats->status_503);
+    printf("By Class: 2xx=%lu 3xx=%lu 4xx=%lu 5xx=%lu other=%lu\n",
+           stats->status_class[2], stats->status_class[3], stats->status_class[4],
+           stats->status_class[5], stats->status_class[0] + stats->status_class[1]);
     printf("Bytes Transferred: %lu\n", stats->bytes_transferred);
+    static const int windows[RATE_WINDOW_COUNT] = RATE_WINDOWS;
+    rate_stats_t rates[RATE_WINDOW_COUNT];
+    for (int r = 0; r < RATE_WINDOW_COUNT; r++) stats_rates(handles, windows[r], &rates[r]);
+    printf("Requests/s (1s / 10s / 60s): %.1f / %.1f / %.1f\n", rates[0].requests, rates[1].requests, rates[2].requests);
+    printf("MB/s (1s / 10s / 60s): %.2f / %.2f / %.2f\n", rates[0].bytes / (1024 * 1024),
+           rates[1].bytes / (1024 * 1024), rates[2].bytes / (1024 * 1024));
+    printf("Errors/s 4xx | 5xx (1s / 10s / 60s): %.1f / %.1f / %.1f | %.1f / %.1f / %.1f\n",
+           rates[0].status_class[4], rates[1].status_class[4], rates[2].status_class[4],
+           rates[0].status_class[5], rates[1].status_class[5], rates[2].status_class[5]);
+    static const uint64_t bounds[RATE_BUCKETS - 1] = RATE_BOUNDS_US;
+    const rate_stats_t *longest = &rates[RATE_WINDOW_COUNT - 1];
+    printf("Latency last %ds:", windows[RATE_WINDOW_COUNT - 1]);
+    for (int b = 0; b < RATE_BUCKETS; b++) {
+        if (b < RATE_BUCKETS - 1) printf(" <=%lums %lu", bounds[b] / 1000, longest->latency[b]);
+        else printf(" >%lums %lu", bounds[b - 1] / 1000, longest->latency[b]);
+    }
+    printf("\n");
     printf("Active Connections: %u\n", stats->active_connections);
-    printf("Average Response Time: %lu ms\n", avg_response_time_ms);
-    printf("========================================\n\n");
+    printf("Accept Queue: %u / %u\n", __atomic_load_n(&handles->shared_data->accept_queue, __ATOMIC_RELAXED),
+           __atomic_load_n(&handles->shared_data->accept_backlog, __ATOMIC_RELAXED));
+    printf("Average Response Time: %.3f ms\n", avg_response_time_ms);
+    print_latency("Latency lifetime", &stats->latency);
+    print_latency("Latency last " STATS_WINDOW_LABEL, &stats->latency_window);
+    static const char *stage_names[] = STAGE_NAMES;
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        const hist_t *h = &stats->stages[i];
+        printf("Stage %-6s (us): avg=%.1f p50=%lu p99=%lu (%lu requests)\n", stage_names[i],
+               h->count ? (double)h->sum_us / h->count : 0.0, hist_percentile(h, 50), hist_percentile(h, 99), h->count);
+    }
+    printf("CPU vs Wall: %.1f%% (avg %.1f us of %.1f us)\n",
+           stats->latency.sum_us ? 100.0 * stats->cpu.sum_us / stats->latency.sum_us : 0.0,
+           stats->cpu.count ? (double)stats->cpu.sum_us / stats->cpu.count : 0.0,
+           stats->latency.count ? (double)stats->latency.sum_us / stats->latency.count : 0.0);
+    printf("Allocations/Request: avg %.1f (%.0f bytes), max %lu\n",
+           stats->latency.count ? (double)stats->request_allocs / stats->latency.count : 0.0,
+           stats->latency.count ? (double)stats->request_alloc_bytes / stats->latency.count : 0.0,
+           stats->request_allocs_max);
+
+    static const char *vhost_names[] = VHOST_NAMES;
+    for (int v = 0; v < VHOST_COUNT; v++) {
+        tcp_stats_t t;
+        stats_tcp(handles, v, &t);
+        if (t.samples == 0) continue;
+        printf("TCP %-7s: %lu samples, RTT p50=%lu p99=%lu us, %lu retransmitted, %lu unacked at close, "
+               "cwnd avg %.1f, delivery p50=%lu KB/s\n", vhost_names[v], t.samples,
+               hist_percentile(&t.rtt, 50), hist_percentile(&t.rtt, 99), t.retransmitted, t.unacked,
+               (double)t.cwnd_sum / t.samples, hist_percentile(&t.delivery, 50));
+    }
 
-    sem_post(handles->sem_stats);
-}
\ No newline at end of file
+    // Cache (soma dos workers) e orçamento de cada um
+    cache_stats_t cache;
+    stats_cache_totals(handles, &cache);
+    uint64_t lookups = cache.hits + cache.misses;
+    printf("Cache Hit Rate: %.1f%% (%lu hits, %lu in L1, %lu misses)\n",
+           lookups ? 100.0 * cache.hits / lookups : 0.0, cache.hits, cache.l1_hits, cache.misses);
+    printf("Cache Evictions: %lu capacity, %lu stale, %lu resize\n",
+           cache.evictions_capacity, cache.evictions_stale, cache.evictions_resize);
+    printf("Cache Rejected: %lu admission, %lu size\n", cache.admission_rejects, cache.size_rejects);
+    printf("Cache Average Fill: %.2f ms\n", cache.fills ? cache.fill_time_us / 1000.0 / cache.fills : 0.0);
+    path_rate_t top[TOPN_PUBLISH];
+    stats_top_paths(handles, 0, top);
+    for (int k = 0; k < 5 && top[k].path[0]; k++) printf("Top Requests #%d: %s (%.1f req/s)\n", k + 1, top[k].path, top[k].rate);
+    stats_top_paths(handles, 1, top);
+    for (int k = 0; k < 5 && top[k].path[0]; k++) printf("Top Bytes #%d: %s (%.1f KB/s)\n", k + 1, top[k].path, top[k].rate / 1024);
+    for (int i = 0; i < handles->shared_data->num_workers && i < MAX_WORKERS; i++) {
+        cache_stats_t w;
+        stats_worker_cache(handles, i, &w);
+        printf("Worker %d Cache: %lu entries, %.2f / %.2f MB\n", i, w.entries,
+               (double)w.bytes_used / (1024 * 1024), (double)w.bytes_budget / (1024 * 1024));
+        proc_stats_t p;
+        stats_worker_proc(handles, i, &p);
+        printf("Worker %d Process: RSS %.2f MB, %lu/%lu faults, %.2f switches/req", i, (double)p.rss_bytes / (1024 * 1024),
+               p.minor_faults, p.major_faults, p.switches_per_request);
+        if (p.perf_enabled == 2) {
+            printf(", %.0f cycles/req, IPC %.2f, %.1f cache misses/req",
+                   p.cycles_per_request, p.instructions_per_cycle, p.cache_misses_per_request);
+        }
+        printf("\n");
+        mem_stats_t m;
+        stats_worker_mem(handles, i, &m);
+        printf("Worker %d Memory: cache %.2f data + %.2f meta MB (%.2f MB reserved), buffers %.1f KB conn + %.1f KB log, "
+               "heap %.2f MB used + %.2f MB mmap, %.2f MB free\n", i,
+               (double)w.data_bytes / (1024 * 1024), (double)w.meta_bytes / (1024 * 1024), (double)w.reserved_bytes / (1024 * 1024),
+               m.conn_buffers / 1024.0, m.log_buffers / 1024.0, (double)m.heap_in_use / (1024 * 1024),
+               (double)m.heap_mmap / (1024 * 1024), (double)m.heap_free / (1024 * 1024));
+    }
+    printf("========================================\n\n");
+}
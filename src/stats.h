@@ -2,19 +2,305 @@
 #define STATS_H
 
 #include <stdint.h>
+#include <string.h>
 #include <time.h>
+#include "histogram.h"
+#include "memstat.h"
 
+#define MAX_WORKERS 64
+#define STATUS_CLASSES 6 // Índice = código / 100 (0 = código inválido)
+#define STATS_WINDOW_SECONDS 60 // Janela deslizante dos percentis
+#define STATS_WINDOW_LABEL "60s"
+#define STATS_HISTORY_SECONDS 300 // Anel de contadores por segundo (últimos 5 minutos)
+#define STATS_JSON_BASE 32768     // /stats.json renderizado pelo master: totais, ritmos, etapas e top
+#define STATS_JSON_PER_WORKER 1024 // Secção de um worker (~760 bytes com todos os números no máximo)
+#define STATS_JSON_MAX (STATS_JSON_BASE + MAX_WORKERS * STATS_JSON_PER_WORKER)
+
+// Etapas de um pedido (histograma próprio para cada uma)
+typedef enum {
+    STAGE_RECV,   // Leitura do pedido
+    STAGE_PARSE,  // Linha do pedido, cabeçalhos e virtual host
+    STAGE_CACHE,  // Pré-carregamento, cache negativa e cache do worker
+    STAGE_DISK,   // open/read do ficheiro
+    STAGE_HEADER, // Formatação dos cabeçalhos da resposta
+    STAGE_SEND,   // Envio (inclui respostas geradas: erros, /stats, /metrics)
+    STAGE_LOG,    // Escrita no access.log
+    STAGE_COUNT
+} stage_t;
+
+#define STAGE_NAMES { "recv", "parse", "cache", "disk", "header", "send", "log" }
+
+// Visão agregada (soma de todos os slots) usada pelo dashboard e pelo master
 typedef struct {
     uint64_t total_requests;
     uint64_t bytes_transferred;
-    uint32_t status_200;
-    uint32_t status_404;
-    uint32_t status_403;
-    uint32_t status_500;
-    uint32_t status_503;
+    uint64_t status_class[STATUS_CLASSES];
+    uint64_t status_200;
+    uint64_t status_404;
+    uint64_t status_403;
+    uint64_t status_500;
+    uint64_t status_503;
     uint32_t active_connections;
     time_t start_time;
-    uint64_t total_response_time_ms;
+    hist_t latency;        // Desde o arranque
+    hist_t latency_window; // Últimos STATS_WINDOW_SECONDS (calculado pelo master)
+    hist_t stages[STAGE_COUNT];
+    hist_t cpu;            // Tempo de CPU da thread por pedido (comparar com latency)
+    uint64_t request_allocs;      // malloc/calloc/realloc feitos durante os pedidos
+    uint64_t request_alloc_bytes;
+    uint64_t request_allocs_max;  // Mais alocações num só pedido
 } server_stats_t;
 
+// Contadores de uma thread. Cada slot tem as suas próprias linhas de cache e um único
+// escritor (a thread dona), por isso não há atomics partilhados nem semáforos no caminho
+// do pedido. "seq" é um seqlock: ímpar enquanto a thread está a escrever.
+typedef struct {
+    uint32_t seq;
+    uint64_t requests;
+    uint64_t bytes;
+    uint64_t opened;              // Conexões aceites (ativas = opened - closed)
+    uint64_t closed;
+    uint64_t status_class[STATUS_CLASSES];
+    uint64_t status_200;
+    uint64_t status_404;
+    uint64_t status_403;
+    uint64_t status_500;
+    uint64_t status_503;
+    hist_t latency;               // Duração de cada pedido (us)
+    hist_t stages[STAGE_COUNT];   // Só conta os pedidos que passaram pela etapa
+    hist_t cpu;
+    uint64_t allocs;              // Alocações dos pedidos (memstat)
+    uint64_t alloc_bytes;
+    uint64_t allocs_max;
+} __attribute__((aligned(64))) stats_slot_t;
+
+// Contadores da cache de um worker
+typedef struct {
+    uint64_t hits;               // Inclui os hits no L1 das threads
+    uint64_t l1_hits;
+    uint64_t misses;
+    uint64_t evictions_capacity; // Expulsas para dar lugar a outras
+    uint64_t evictions_stale;    // Substituídas por uma versão nova do ficheiro
+    uint64_t evictions_resize;   // Expulsas ao encolher o orçamento (CACHE_ADAPTIVE)
+    uint64_t admission_rejects;  // Recusadas pelo filtro de admissão
+    uint64_t size_rejects;       // Maiores do que CACHE_MAX_OBJECT_KB
+    uint64_t fills;              // Carregamentos do disco
+    uint64_t fill_time_us;       // Soma dos tempos de carregamento
+    uint64_t bytes_used;
+    uint64_t bytes_budget;       // Orçamento atual (muda com CACHE_ADAPTIVE)
+    uint64_t entries;
+    uint64_t data_bytes;         // Corpos dos ficheiros
+    uint64_t meta_bytes;         // Entradas, chaves, arredondamento dos blocos, hash, sketch e heap
+    uint64_t reserved_bytes;     // Arena pré-alocada (0 sem CACHE_ARENA)
+} cache_stats_t;
+
+// Memória de um worker fora da cache, amostrada 1x por segundo
+typedef struct {
+    uint64_t conn_buffers;       // Buffers fixos das threads de pedidos + leituras de ficheiros em curso
+    uint64_t log_buffers;        // Buffer do access.log e filas do trace
+    uint64_t heap_arena;         // mallinfo2: memória das arenas do malloc (brk e arenas das threads)
+    uint64_t heap_mmap;          // Blocos grandes servidos diretamente por mmap
+    uint64_t heap_in_use;        // Alocado nas arenas
+    uint64_t heap_free;          // Livre nas arenas (fragmentação ou ainda não devolvido)
+} mem_stats_t;
+
+// Contadores do processo de um worker (perfstat), publicados 1x por segundo
+typedef struct {
+    uint64_t rss_bytes;
+    uint64_t minor_faults;         // Processo inteiro (getrusage)
+    uint64_t major_faults;
+    uint64_t voluntary_switches;
+    uint64_t involuntary_switches;
+    int perf_enabled;              // 0 = PERF_COUNTERS desligado, 1 = só software, 2 = com hardware
+    uint64_t cycles;               // perf_event_open, só as threads dos pedidos
+    uint64_t instructions;
+    uint64_t cache_misses;
+    uint64_t context_switches;     // Sem perf: as trocas do getrusage
+    double cycles_per_request;     // Rácios do último segundo com pedidos
+    double instructions_per_cycle;
+    double cache_misses_per_request;
+    double switches_per_request;
+} proc_stats_t;
+
+// Virtual hosts servidos (índice escolhido pelo Host do pedido em http.c)
+enum { VHOST_DEFAULT, VHOST_SITE1, VHOST_SITE2, VHOST_COUNT };
+#define VHOST_NAMES { "default", "site1", "site2" }
+
+// TCP_INFO de uma conexão, lido ao fechar (TCP_INFO_SAMPLE_RATE)
+typedef struct {
+    uint32_t rtt_us;           // RTT suavizado do kernel
+    uint32_t rttvar_us;
+    uint32_t retransmits;      // Segmentos retransmitidos durante a conexão
+    uint32_t cwnd;             // Janela de congestionamento (segmentos)
+    uint32_t unacked;          // Segmentos ainda por confirmar quando a resposta "acabou"
+    uint64_t bytes_acked;
+    uint64_t delivery_rate;    // Bytes/s (0 se o kernel não souber)
+} tcp_sample_t;
+
+// Amostras de TCP_INFO de um virtual host
+typedef struct {
+    uint64_t samples;
+    uint64_t retransmits;
+    uint64_t retransmitted;    // Conexões com pelo menos uma retransmissão
+    uint64_t unacked;          // Conexões fechadas com dados por confirmar
+    uint64_t bytes_acked;
+    uint64_t cwnd_sum;
+    uint64_t rttvar_sum;
+    hist_t rtt;                // us
+    hist_t delivery;           // KB/s
+} tcp_stats_t;
+
+// Buckets de latência guardados por segundo: limites em us, o último bucket é "acima de"
+#define RATE_BOUNDS_US { 1000, 5000, 25000, 100000, 500000 }
+#define RATE_BUCKETS 6
+#define RATE_WINDOWS { 1, 10, 60 } // Janelas dos ritmos mostrados (segundos)
+#define RATE_WINDOW_COUNT 3
+
+// Um segundo do anel: diferença entre duas fotografias consecutivas do master
+typedef struct {
+    time_t second;                       // Fim do intervalo (0 = ainda vazio)
+    uint64_t requests;
+    uint64_t bytes;
+    uint64_t status_class[STATUS_CLASSES];
+    uint64_t latency[RATE_BUCKETS];      // Pedidos por bucket de RATE_BOUNDS_US
+} second_stats_t;
+
+// Médias dos últimos N segundos do anel
+typedef struct {
+    int seconds;                         // Segundos cobertos (menos do que N logo após o arranque)
+    double requests;                     // Por segundo
+    double bytes;
+    double status_class[STATUS_CLASSES];
+    uint64_t latency[RATE_BUCKETS];      // Pedidos na janela por bucket (totais, não ritmos)
+} rate_stats_t;
+
+#define TOPN_PUBLISH 10   // Caminhos mais pedidos publicados por worker (e mostrados)
+#define TOPN_PATH_MAX 128
+
+// Caminho e ritmo recente (média exponencial de ~1 minuto, por segundo)
+typedef struct {
+    char path[TOPN_PATH_MAX];
+    double rate;
+} path_rate_t;
+
+#define SLOW_RING_SIZE 32 // Últimos pedidos lentos guardados por worker
+
+// Pedido acima de SLOW_REQUEST_MS. Escrito por qualquer thread do worker sem locks:
+// cada uma reserva um bilhete e "seq" fica 2*bilhete+1 durante a escrita e 2*bilhete+2 no fim.
+typedef struct {
+    uint32_t seq;
+    int32_t worker;
+    time_t when;
+    uint32_t total_us;
+    uint32_t cpu_us;
+    uint32_t stage_us[STAGE_COUNT];
+    uint32_t allocs;
+    uint64_t bytes;
+    uint16_t status;
+    uint8_t cache_hit;
+    char client[64];  // "endereço:porto"
+    char vhost[64];
+    char path[TOPN_PATH_MAX];
+} slow_entry_t;
+
+// Estado publicado por cada worker no seu próprio slot (só ele escreve, com seqlock)
+typedef struct {
+    uint32_t seq;
+    cache_stats_t cache;
+    uint32_t proc_seq;
+    proc_stats_t proc;
+    mem_stats_t mem;                     // Também sob proc_seq
+    uint32_t tcp_lock;                   // Escritores: qualquer thread do worker (só nas amostras)
+    uint32_t tcp_seq;
+    tcp_stats_t tcp[VHOST_COUNT];
+    uint32_t top_seq;
+    path_rate_t top_hits[TOPN_PUBLISH];  // Pedidos/s, ordenado
+    path_rate_t top_bytes[TOPN_PUBLISH]; // Bytes/s, ordenado
+    uint32_t slow_next;                  // Próximo bilhete do anel (threads do worker)
+    slow_entry_t slow[SLOW_RING_SIZE];
+} __attribute__((aligned(64))) worker_stats_t;
+
+#define TIMING_MAX_SPANS 24 // Leituras do disco em chunks geram vários intervalos
+
+// Tempos de um pedido: cada marca soma o tempo desde a anterior à etapa indicada
+typedef struct {
+    struct timespec accepted; // accept() devolveu a conexão (antes do start)
+    struct timespec start;
+    struct timespec mark;
+    struct timespec cpu_start;
+    alloc_counter_t allocs_start;
+    uint64_t stage_us[STAGE_COUNT];
+    uint32_t touched; // Bit por etapa
+    // Contexto guardado se o pedido for lento
+    int client_fd;
+    const char *path;
+    const char *vhost;
+    uint64_t bytes;
+    int status;
+    int cache_hit;
+    // Pedido amostrado para o trace (TRACE_SAMPLE_RATE): guarda cada intervalo
+    int sampled;
+    uint32_t queue_us; // Estimativa do tempo na fila do listen() (só nos amostrados)
+    int num_spans;
+    struct {
+        uint32_t offset_us; // Desde o início do pedido
+        uint32_t dur_us;
+        uint8_t stage;
+    } spans[TIMING_MAX_SPANS];
+} request_timing_t;
+
+static inline uint64_t timespec_diff_us(const struct timespec *a, const struct timespec *b) {
+    return (uint64_t)((b->tv_sec - a->tv_sec) * 1000000 + (b->tv_nsec - a->tv_nsec) / 1000);
+}
+
+static inline void timing_start(request_timing_t *t, int client_fd, const struct timespec *accepted) {
+    memset(t, 0, sizeof(*t));
+    t->client_fd = client_fd;
+    t->status = 200;
+    clock_gettime(CLOCK_MONOTONIC, &t->start);
+    t->accepted = accepted ? *accepted : t->start;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t->cpu_start);
+    t->allocs_start = memstat_thread_allocs;
+    t->mark = t->start;
+}
+
+static inline void timing_mark(request_timing_t *t, stage_t stage) {
+    if (!t) return;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t dur = timespec_diff_us(&t->mark, &now);
+    t->stage_us[stage] += dur;
+    t->touched |= 1u << stage;
+    if (t->sampled && t->num_spans < TIMING_MAX_SPANS) {
+        t->spans[t->num_spans].offset_us = (uint32_t)timespec_diff_us(&t->start, &t->mark);
+        t->spans[t->num_spans].dur_us = (uint32_t)dur;
+        t->spans[t->num_spans].stage = stage;
+        t->num_spans++;
+    }
+    t->mark = now;
+}
+
+// Seqlock com um único escritor: o contador fica ímpar durante a escrita.
+// Os leitores copiam e repetem se o contador mudou ou estava ímpar.
+static inline void seq_write_begin(uint32_t *seq) {
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void seq_write_end(uint32_t *seq) {
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+}
+
+// Desiste ao fim de SEQ_MAX_RETRIES (um worker que morra a meio de uma escrita deixa o contador ímpar)
+#define SEQ_MAX_RETRIES 1000
+
+static inline void seq_read(const uint32_t *seq, void *dst, const void *src, size_t len) {
+    for (int tries = 0; ; tries++) {
+        uint32_t before = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+        memcpy(dst, src, len);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if ((!(before & 1) && __atomic_load_n(seq, __ATOMIC_RELAXED) == before) || tries >= SEQ_MAX_RETRIES) return;
+    }
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,46 @@
+#include "tcpinfo.h"
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/tcp.h> // A struct tcp_info da glibc não tem bytes_acked nem delivery_rate
+
+static __thread unsigned int tls_count = 0;
+
+void tcpinfo_sample(ipc_handles_t *ipc, int client_fd, int vhost) {
+    if (!ipc || !ipc->shared_data) return;
+    uint32_t rate = ipc->shared_data->tcp_sample_rate;
+    if (rate == 0 || ++tls_count % rate != 0) return;
+
+    // Kernels antigos devolvem uma struct mais curta: o que faltar fica a zero
+    struct tcp_info info;
+    memset(&info, 0, sizeof(info));
+    socklen_t len = sizeof(info);
+    if (getsockopt(client_fd, IPPROTO_TCP, TCP_INFO, &info, &len) != 0) return;
+
+    tcp_sample_t sample = {
+        .rtt_us = info.tcpi_rtt,
+        .rttvar_us = info.tcpi_rttvar,
+        .retransmits = info.tcpi_total_retrans,
+        .cwnd = info.tcpi_snd_cwnd,
+        .unacked = info.tcpi_unacked,
+        .bytes_acked = info.tcpi_bytes_acked,
+        .delivery_rate = info.tcpi_delivery_rate
+    };
+    stats_record_tcp(ipc, vhost, &sample);
+}
+
+uint32_t tcpinfo_queue_us(int client_fd, const struct timespec *accepted) {
+    struct tcp_info info;
+    memset(&info, 0, sizeof(info));
+    socklen_t len = sizeof(info);
+    if (getsockopt(client_fd, IPPROTO_TCP, TCP_INFO, &info, &len) != 0) return 0;
+
+    // tcpi_last_data_recv conta até agora: desconta o que já passou desde o accept
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t since_data = (uint64_t)info.tcpi_last_data_recv * 1000;
+    uint64_t since_accept = timespec_diff_us(accepted, &now);
+    if (since_data <= since_accept) return 0;
+    uint64_t queued = since_data - since_accept;
+    return queued > UINT32_MAX ? UINT32_MAX : (uint32_t)queued;
+}
@@ -0,0 +1,15 @@
+#ifndef TCPINFO_H
+#define TCPINFO_H
+
+#include "master.h"
+
+// Diagnóstico do lado do cliente: 1 em cada TCP_INFO_SAMPLE_RATE conexões de cada thread lê
+// TCP_INFO antes do close (RTT, retransmissões, cwnd, bytes confirmados, delivery rate) e soma
+// a amostra ao virtual host na memória partilhada. Diz se a cauda da latência é rede ou servidor.
+void tcpinfo_sample(ipc_handles_t *ipc, int client_fd, int vhost);
+
+// Tempo (us) que a conexão esperou na fila do listen() antes do accept, a partir do último
+// pacote recebido (fim do handshake ou o próprio pedido). Resolução de um jiffy; 0 se não souber.
+uint32_t tcpinfo_queue_us(int client_fd, const struct timespec *accepted);
+
+#endif
@@ -0,0 +1,201 @@
+#define _POSIX_C_SOURCE 200809L
+#include "topn.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define TOPN_SLOTS 64         // Contadores do sketch de cada thread
+#define TOPN_AGG 256          // Contadores da média do worker
+#define TOPN_DECAY 0.98851    // 0.5^(1/60) por segundo: meia-vida de 60 s
+#define TOPN_MIN_WEIGHT 0.01  // Abaixo disto a entrada sai da média
+
+// Space-saving: com o sketch cheio, um caminho novo substitui o contador mínimo e herda
+// o seu valor (sobrestima no máximo esse mínimo; os caminhos frequentes nunca saem)
+typedef struct {
+    uint64_t hash[TOPN_SLOTS]; // Separado para a procura percorrer poucas linhas de cache
+    uint64_t count[TOPN_SLOTS];
+    char path[TOPN_SLOTS][TOPN_PATH_MAX];
+    int used;
+} ss_sketch_t;
+
+typedef struct {
+    pthread_mutex_t lock; // Só disputado durante a recolha
+    ss_sketch_t hits;
+    ss_sketch_t bytes;
+} thread_topn_t;
+
+typedef struct {
+    uint64_t hash;
+    double weight;
+    char path[TOPN_PATH_MAX];
+} agg_entry_t;
+
+typedef struct {
+    agg_entry_t e[TOPN_AGG];
+    int used;
+} agg_t;
+
+static thread_topn_t *g_threads = NULL;
+static int g_num_threads = 0;
+static int g_next_thread = 0;
+static __thread thread_topn_t *tls_topn = NULL;
+
+// Só usados pela thread principal do worker
+static agg_t g_agg_hits, g_agg_bytes;
+static ss_sketch_t g_drain;
+
+// FNV-1a de 64 bits
+static uint64_t hash_path(const char *path) {
+    uint64_t h = 1469598103934665603ULL;
+    while (*path) {
+        h ^= (unsigned char)*path++;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static void ss_add(ss_sketch_t *sk, uint64_t hash, const char *path, uint64_t w) {
+    for (int i = 0; i < sk->used; i++) {
+        if (sk->hash[i] == hash) {
+            sk->count[i] += w;
+            return;
+        }
+    }
+
+    int slot = sk->used;
+    uint64_t base = 0;
+    if (slot < TOPN_SLOTS) {
+        sk->used++;
+    } else {
+        slot = 0;
+        for (int i = 1; i < TOPN_SLOTS; i++) {
+            if (sk->count[i] < sk->count[slot]) slot = i;
+        }
+        base = sk->count[slot];
+    }
+    sk->hash[slot] = hash;
+    sk->count[slot] = base + w;
+    strncpy(sk->path[slot], path, TOPN_PATH_MAX - 1);
+    sk->path[slot][TOPN_PATH_MAX - 1] = '\0';
+}
+
+static void agg_add(agg_t *a, uint64_t hash, const char *path, double w) {
+    for (int i = 0; i < a->used; i++) {
+        if (a->e[i].hash == hash) {
+            a->e[i].weight += w;
+            return;
+        }
+    }
+
+    int slot = a->used;
+    double base = 0;
+    if (slot < TOPN_AGG) {
+        a->used++;
+    } else {
+        slot = 0;
+        for (int i = 1; i < TOPN_AGG; i++) {
+            if (a->e[i].weight < a->e[slot].weight) slot = i;
+        }
+        base = a->e[slot].weight;
+    }
+    a->e[slot].hash = hash;
+    a->e[slot].weight = base + w;
+    memcpy(a->e[slot].path, path, TOPN_PATH_MAX);
+}
+
+static void agg_decay(agg_t *a) {
+    for (int i = 0; i < a->used; ) {
+        a->e[i].weight *= TOPN_DECAY;
+        if (a->e[i].weight < TOPN_MIN_WEIGHT) {
+            a->e[i] = a->e[--a->used];
+            continue;
+        }
+        i++;
+    }
+}
+
+static void agg_merge(agg_t *a, const ss_sketch_t *sk) {
+    for (int i = 0; i < sk->used; i++) agg_add(a, sk->hash[i], sk->path[i], (double)sk->count[i]);
+}
+
+// Top por seleção parcial (TOPN_PUBLISH passagens sobre no máximo TOPN_AGG entradas)
+static void agg_top(agg_t *a, path_rate_t *out) {
+    char taken[TOPN_AGG] = {0};
+    for (int k = 0; k < TOPN_PUBLISH; k++) {
+        int best = -1;
+        for (int i = 0; i < a->used; i++) {
+            if (!taken[i] && (best < 0 || a->e[i].weight > a->e[best].weight)) best = i;
+        }
+        if (best < 0) {
+            out[k].path[0] = '\0';
+            out[k].rate = 0;
+            continue;
+        }
+        taken[best] = 1;
+        memcpy(out[k].path, a->e[best].path, TOPN_PATH_MAX);
+        // Em regime estável o peso converge para ritmo / (1 - decay)
+        out[k].rate = a->e[best].weight * (1.0 - TOPN_DECAY);
+    }
+}
+
+int topn_init(int num_threads) {
+    if (num_threads <= 0) return -1;
+    g_threads = calloc(num_threads, sizeof(thread_topn_t));
+    if (!g_threads) return -1;
+    for (int i = 0; i < num_threads; i++) pthread_mutex_init(&g_threads[i].lock, NULL);
+    g_num_threads = num_threads;
+    g_next_thread = 0;
+    g_agg_hits.used = g_agg_bytes.used = 0;
+    return 0;
+}
+
+void topn_record(const char *path, uint64_t bytes) {
+    thread_topn_t *t = tls_topn;
+    if (!t) {
+        // Primeiro pedido desta thread: reserva um sketch
+        if (!g_threads) return;
+        int idx = __sync_fetch_and_add(&g_next_thread, 1);
+        if (idx >= g_num_threads) return;
+        t = tls_topn = &g_threads[idx];
+    }
+
+    uint64_t hash = hash_path(path);
+    pthread_mutex_lock(&t->lock);
+    ss_add(&t->hits, hash, path, 1);
+    if (bytes > 0) ss_add(&t->bytes, hash, path, bytes);
+    pthread_mutex_unlock(&t->lock);
+}
+
+void topn_collect(path_rate_t *hits, path_rate_t *bytes) {
+    agg_decay(&g_agg_hits);
+    agg_decay(&g_agg_bytes);
+
+    int active = __atomic_load_n(&g_next_thread, __ATOMIC_RELAXED);
+    if (active > g_num_threads) active = g_num_threads;
+    for (int i = 0; i < active; i++) {
+        thread_topn_t *t = &g_threads[i];
+        // Copia e esvazia sob o lock; a junção é feita fora dele
+        pthread_mutex_lock(&t->lock);
+        g_drain = t->hits;
+        t->hits.used = 0;
+        pthread_mutex_unlock(&t->lock);
+        agg_merge(&g_agg_hits, &g_drain);
+
+        pthread_mutex_lock(&t->lock);
+        g_drain = t->bytes;
+        t->bytes.used = 0;
+        pthread_mutex_unlock(&t->lock);
+        agg_merge(&g_agg_bytes, &g_drain);
+    }
+
+    agg_top(&g_agg_hits, hits);
+    agg_top(&g_agg_bytes, bytes);
+}
+
+void topn_cleanup(void) {
+    if (!g_threads) return;
+    for (int i = 0; i < g_num_threads; i++) pthread_mutex_destroy(&g_threads[i].lock);
+    free(g_threads);
+    g_threads = NULL;
+    g_num_threads = 0;
+}
@@ -0,0 +1,22 @@
+#ifndef TOPN_H
+#define TOPN_H
+
+#include <stdint.h>
+#include "stats.h"
+
+// Caminhos mais pedidos (por pedidos e por bytes) com memória constante.
+// Cada thread tem um sketch space-saving próprio (sem contenção no pedido); 1x por segundo o
+// worker esvazia-os para uma média exponencial (meia-vida de 60 s) e publica o top.
+// Estado por processo: cada worker chama topn_init depois do fork.
+int topn_init(int num_threads);
+
+// Regista um pedido servido (thread do pedido)
+void topn_record(const char *path, uint64_t bytes);
+
+// Worker, 1x por segundo: recolhe os sketches e devolve o top ordenado (TOPN_PUBLISH
+// entradas cada; as que sobram ficam com o caminho vazio)
+void topn_collect(path_rate_t *hits, path_rate_t *bytes);
+
+void topn_cleanup(void);
+
+#endif
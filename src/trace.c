@@ -0,0 +1,187 @@
+#define _GNU_SOURCE
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <time.h>
+
+#define TRACE_QUEUE 256        // Pedidos à espera da thread de escrita
+#define TRACE_FLUSH_MS 200
+
+typedef struct {
+    uint64_t start_us;         // CLOCK_MONOTONIC
+    uint32_t total_us;
+    uint32_t accept_us;        // Do accept até a thread começar o pedido
+    uint32_t queue_us;         // Na fila do listen() antes do accept (estimativa)
+    int tid;
+    int status;
+    int cache_hit;
+    uint64_t bytes;
+    char method[8];
+    char path[TOPN_PATH_MAX];
+    int num_spans;
+    struct {
+        uint32_t offset_us;
+        uint32_t dur_us;
+        uint8_t stage;
+    } spans[TIMING_MAX_SPANS];
+} trace_record_t;
+
+static int g_rate = 0;
+static int g_worker_id = 0;
+static FILE *g_file = NULL;
+
+static trace_record_t g_queue[TRACE_QUEUE];
+static int g_queued = 0;
+static unsigned long g_dropped = 0;
+static pthread_mutex_t g_queue_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static trace_record_t g_batch[TRACE_QUEUE]; // Só usado pela thread de escrita
+static pthread_t g_writer;
+static int g_writer_started = 0;
+static volatile int g_writer_stop = 0;
+
+static __thread unsigned int tls_count = 0;
+static __thread int tls_tid = 0;
+
+// Escapa o caminho para dentro de uma string JSON
+static void write_escaped(FILE *f, const char *str) {
+    for (const unsigned char *p = (const unsigned char*)str; *p; p++) {
+        if (*p == '"' || *p == '\\') fprintf(f, "\\%c", *p);
+        else if (*p < 0x20) fprintf(f, "\\u%04x", *p);
+        else fputc(*p, f);
+    }
+}
+
+static void write_record(FILE *f, const trace_record_t *r) {
+    static const char *stage_names[] = STAGE_NAMES;
+    int pid = getpid();
+
+    // Antes do pedido: fila do listen() e a passagem do accept para o tratamento
+    uint64_t accepted_us = r->start_us - r->accept_us;
+    if (r->queue_us) {
+        fprintf(f, ",\n{\"name\":\"queue\",\"cat\":\"connection\",\"ph\":\"X\",\"ts\":%lu,\"dur\":%u,\"pid\":%d,\"tid\":%d}",
+                accepted_us - r->queue_us, r->queue_us, pid, r->tid);
+    }
+    if (r->accept_us) {
+        fprintf(f, ",\n{\"name\":\"accept\",\"cat\":\"connection\",\"ph\":\"X\",\"ts\":%lu,\"dur\":%u,\"pid\":%d,\"tid\":%d}",
+                accepted_us, r->accept_us, pid, r->tid);
+    }
+
+    // Intervalo do pedido inteiro, com as etapas por baixo
+    fprintf(f, ",\n{\"name\":\"");
+    write_escaped(f, r->method);
+    fputc(' ', f);
+    write_escaped(f, r->path);
+    fprintf(f, "\",\"cat\":\"request\",\"ph\":\"X\",\"ts\":%lu,\"dur\":%u,\"pid\":%d,\"tid\":%d,"
+               "\"args\":{\"status\":%d,\"bytes\":%lu,\"cache\":\"%s\"}}",
+            r->start_us, r->total_us, pid, r->tid, r->status, r->bytes, r->cache_hit ? "hit" : "miss");
+
+    for (int i = 0; i < r->num_spans; i++) {
+        if (r->spans[i].dur_us == 0) continue;
+        fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"stage\",\"ph\":\"X\",\"ts\":%lu,\"dur\":%u,\"pid\":%d,\"tid\":%d}",
+                stage_names[r->spans[i].stage], r->start_us + r->spans[i].offset_us, r->spans[i].dur_us, pid, r->tid);
+    }
+}
+
+static void flush_queue(void) {
+    pthread_mutex_lock(&g_queue_lock);
+    int n = g_queued;
+    memcpy(g_batch, g_queue, n * sizeof(trace_record_t));
+    g_queued = 0;
+    pthread_mutex_unlock(&g_queue_lock);
+
+    for (int i = 0; i < n; i++) write_record(g_file, &g_batch[i]);
+    if (n > 0) fflush(g_file);
+}
+
+static void *writer_thread_fn(void *arg) {
+    (void)arg;
+    while (!g_writer_stop) {
+        struct timespec ts = { 0, TRACE_FLUSH_MS * 1000000L };
+        nanosleep(&ts, NULL);
+        flush_queue();
+    }
+    flush_queue();
+    return NULL;
+}
+
+int trace_init(const server_config_t *config, int worker_id) {
+    if (config->trace_sample_rate <= 0 || config->trace_file[0] == '\0') return 0;
+
+    char path[300];
+    snprintf(path, sizeof(path), "%s.%d", config->trace_file, worker_id);
+    g_file = fopen(path, "w");
+    if (!g_file) return -1;
+
+    // Formato "JSON Array": o "]" final é opcional, o ficheiro abre mesmo se o worker morrer
+    fprintf(g_file, "[{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"worker %d\"}}",
+            getpid(), worker_id);
+    fflush(g_file);
+
+    g_worker_id = worker_id;
+    g_writer_stop = 0;
+    if (pthread_create(&g_writer, NULL, writer_thread_fn, NULL) != 0) {
+        fclose(g_file);
+        g_file = NULL;
+        return -1;
+    }
+    g_writer_started = 1;
+    g_rate = config->trace_sample_rate;
+    return 0;
+}
+
+int trace_sample(void) {
+    if (g_rate <= 0) return 0;
+    return ++tls_count % g_rate == 0;
+}
+
+void trace_submit(const request_timing_t *timing, const char *method) {
+    if (!g_writer_started || !timing->sampled) return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (!tls_tid) tls_tid = (int)syscall(SYS_gettid);
+
+    pthread_mutex_lock(&g_queue_lock);
+    if (g_queued == TRACE_QUEUE) {
+        g_dropped++;
+        pthread_mutex_unlock(&g_queue_lock);
+        return;
+    }
+    trace_record_t *r = &g_queue[g_queued++];
+    r->start_us = (uint64_t)timing->start.tv_sec * 1000000 + timing->start.tv_nsec / 1000;
+    r->total_us = (uint32_t)timespec_diff_us(&timing->start, &now);
+    r->accept_us = (uint32_t)timespec_diff_us(&timing->accepted, &timing->start);
+    r->queue_us = timing->queue_us;
+    r->tid = tls_tid;
+    r->status = timing->status;
+    r->cache_hit = timing->cache_hit;
+    r->bytes = timing->bytes;
+    snprintf(r->method, sizeof(r->method), "%s", method ? method : "?");
+    snprintf(r->path, sizeof(r->path), "%s", timing->path ? timing->path : "");
+    r->num_spans = timing->num_spans;
+    memcpy(r->spans, timing->spans, timing->num_spans * sizeof(timing->spans[0]));
+    pthread_mutex_unlock(&g_queue_lock);
+}
+
+size_t trace_buffer_bytes(void) {
+    return g_writer_started ? sizeof(g_queue) + sizeof(g_batch) + BUFSIZ : 0;
+}
+
+void trace_cleanup(void) {
+    if (!g_writer_started) return;
+    g_rate = 0;
+    g_writer_stop = 1;
+    pthread_join(g_writer, NULL);
+    g_writer_started = 0;
+    if (g_dropped > 0) {
+        fprintf(stderr, "[WORKER %d] Trace queue full, %lu sampled requests dropped\n", g_worker_id, g_dropped);
+    }
+    fprintf(g_file, "\n]\n");
+    fclose(g_file);
+    g_file = NULL;
+}
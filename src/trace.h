@@ -0,0 +1,24 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "config.h"
+#include "stats.h"
+
+// Trace por pedido no formato de eventos do Chrome (abre em chrome://tracing ou ui.perfetto.dev).
+// 1 em cada TRACE_SAMPLE_RATE pedidos de cada thread fica com os intervalos de cada etapa;
+// uma thread do worker escreve-os em <TRACE_FILE>.<worker> fora do caminho do pedido.
+// Os tempos são CLOCK_MONOTONIC, por isso os ficheiros dos vários workers alinham-se.
+int trace_init(const server_config_t *config, int worker_id);
+
+// 1 se o próximo pedido desta thread deve ser amostrado
+int trace_sample(void);
+
+// Copia o pedido amostrado para a fila da thread de escrita (descarta se estiver cheia)
+void trace_submit(const request_timing_t *timing, const char *method);
+
+// Filas e buffer do ficheiro (0 com o trace desligado)
+size_t trace_buffer_bytes(void);
+
+void trace_cleanup(void);
+
+#endif
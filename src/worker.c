@@ -5,13 +5,22 @@
 #include "master.h"
 #include "logger.h"
 #include "cache.h"
+#include "negcache.h"
+#include "mempressure.h"
+#include "dashboard.h"
+#include "topn.h"
+#include "trace.h"
+#include "perfstat.h"
+#include "probes.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <signal.h>
 #include <sys/socket.h>
 #include <sys/mman.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 
 static volatile int g_stop = 0;
 void term_handler(int sig) { (void)sig; g_stop = 1; }
@@ -22,30 +31,50 @@ typedef struct {
     ipc_handles_t *ipc;
     int listen_fd;
     cache_t *cache;
+    char snapshot_path[300];
 } worker_state_t;
 
 // Anexo IPC simplificado para workers
 int ipc_attach_worker(ipc_handles_t *handles) {
     handles->shm_fd = shm_open(SHM_NAME, O_RDWR, 0666);
-    handles->shared_data = mmap(NULL, sizeof(shared_data_t), PROT_READ|PROT_WRITE, MAP_SHARED, handles->shm_fd, 0);
-    handles->sem_stats = sem_open(SEM_STATS_NAME, 0);
+    // O tamanho depende do número de slots: vem do próprio objeto
+    struct stat st;
+    if (handles->shm_fd < 0 || fstat(handles->shm_fd, &st) != 0) return -1;
+    handles->shm_size = st.st_size;
+    handles->shared_data = mmap(NULL, handles->shm_size, PROT_READ|PROT_WRITE, MAP_SHARED, handles->shm_fd, 0);
     handles->sem_log = sem_open(SEM_LOG_NAME, 0);
     return (handles->shared_data == MAP_FAILED) ? -1 : 0;
 }
 
 static void *worker_thread_fn(void *arg) {
     worker_state_t *st = (worker_state_t*)arg;
+    stats_bind_thread(st->ipc, st->worker_id);
+    perfstat_thread_start();
     while (!g_stop) {
         int client_fd = accept(st->listen_fd, NULL, NULL);
         if (client_fd < 0) continue;
+        struct timespec accepted;
+        clock_gettime(CLOCK_MONOTONIC, &accepted);
+        PROBE_CONN_ACCEPT(client_fd, st->worker_id);
 
         stats_inc_active(st->ipc);
 
         // Processar o request com cache
-        http_handle_request(client_fd, st->config->document_root, st->ipc, st->cache);
+        http_handle_request(client_fd, st->config->document_root, st->ipc, st->cache, &accepted);
 
         stats_dec_active(st->ipc);
     }
+    cache_l1_flush(st->cache);
+    return NULL;
+}
+
+// Aquece a cache com o snapshot do arranque anterior enquanto as threads já aceitam pedidos
+static void *warmup_thread_fn(void *arg) {
+    worker_state_t *st = (worker_state_t*)arg;
+    int loaded = cache_snapshot_load(st->cache, st->snapshot_path, &g_stop);
+    if (loaded > 0) {
+        printf("[WORKER %d] Cache warm-up: %d files loaded from %s\n", st->worker_id, loaded, st->snapshot_path);
+    }
     return NULL;
 }
 
@@ -69,13 +98,38 @@ void worker_main(int worker_id, server_config_t *config, int listen_fd) {
 
     // Inicializar a cache
     printf("[WORKER %d] Initializing cache with %d MB...\n", worker_id, config->cache_size_mb);
-    cache_t *local_cache = cache_init(config->cache_size_mb);
+    cache_t *local_cache = cache_init(config);
     if (!local_cache) {
         fprintf(stderr, "[WORKER %d] Failed to initialize cache\n", worker_id);
         logger_cleanup();
         exit(1);
     }
 
+    // Filtro de ficheiros inexistentes (depois do fork: a thread de inotify é do worker)
+    if (negcache_init(config) != 0) {
+        fprintf(stderr, "[WORKER %d] Document root filter unavailable, using the negative cache only\n", worker_id);
+    }
+
+    // Sketches dos caminhos mais pedidos (um por thread)
+    if (topn_init(config->threads_per_worker) != 0) {
+        fprintf(stderr, "[WORKER %d] Hot path tracking unavailable\n", worker_id);
+    }
+
+    // Contadores do processo (e de hardware, com PERF_COUNTERS)
+    if (perfstat_init(config->perf_counters, config->threads_per_worker) != 0) {
+        fprintf(stderr, "[WORKER %d] Performance counters unavailable\n", worker_id);
+    }
+
+    // Trace amostrado (TRACE_SAMPLE_RATE), escrito por uma thread própria
+    if (trace_init(config, worker_id) != 0) {
+        fprintf(stderr, "[WORKER %d] Cannot open trace file, tracing disabled\n", worker_id);
+    }
+
+    // Thread única que alimenta os clientes do /stats/stream deste worker
+    if (dashboard_stream_init(&ipc, config->stats_stream_clients) != 0) {
+        fprintf(stderr, "[WORKER %d] Live stats stream unavailable\n", worker_id);
+    }
+
     // Estado do worker
     worker_state_t st = {
         .worker_id = worker_id,
@@ -85,10 +139,26 @@ void worker_main(int worker_id, server_config_t *config, int listen_fd) {
         .cache = local_cache
     };
 
+    // Snapshot do hot set (um ficheiro por worker)
+    int use_snapshot = config->cache_snapshot_file[0] != '\0';
+    pthread_t warmup_thread;
+    int warmup_started = 0;
+    if (use_snapshot) {
+        snprintf(st.snapshot_path, sizeof(st.snapshot_path), "%s.%d", config->cache_snapshot_file, worker_id);
+        warmup_started = (pthread_create(&warmup_thread, NULL, warmup_thread_fn, &st) == 0);
+    }
+
     // Criar thread pool
     thread_pool_t pool;
     if (thread_pool_init(&pool, config->threads_per_worker, worker_thread_fn, &st) != 0) {
         fprintf(stderr, "[WORKER %d] Failed to initialize thread pool\n", worker_id);
+        g_stop = 1;
+        if (warmup_started) pthread_join(warmup_thread, NULL);
+        dashboard_stream_cleanup();
+        trace_cleanup();
+        perfstat_cleanup();
+        topn_cleanup();
+        negcache_cleanup();
         cache_destroy(local_cache);
         logger_cleanup();
         exit(1);
@@ -96,12 +166,58 @@ void worker_main(int worker_id, server_config_t *config, int listen_fd) {
 
     printf("[WORKER %d] Ready with %d threads\n", worker_id, config->threads_per_worker);
 
-    while (!g_stop) sleep(1);
+    // Orçamento adaptativo: entre CACHE_MIN_SIZE_MB e CACHE_MAX_SIZE_MB conforme a pressão de memória
+    int adaptive = config->cache_adaptive;
+    if (adaptive && mempressure_init() != 0) {
+        fprintf(stderr, "[WORKER %d] No memory pressure information, cache size stays fixed\n", worker_id);
+        adaptive = 0;
+    }
+    size_t cache_min = (size_t)config->cache_min_size_mb * 1024 * 1024;
+    size_t cache_max = (size_t)(config->cache_max_size_mb > config->cache_size_mb ?
+                                config->cache_max_size_mb : config->cache_size_mb) * 1024 * 1024;
+
+    int since_snapshot = 0;
+    while (!g_stop) {
+        sleep(1);
+        if (adaptive) {
+            mem_sample_t sample;
+            mempressure_sample(&sample);
+            size_t current = cache_capacity(local_cache);
+            size_t target = mempressure_target(&sample, current, cache_min, cache_max);
+            if (target != current) cache_set_capacity(local_cache, target);
+        }
+        cache_stats_t cache_stats;
+        cache_get_stats(local_cache, &cache_stats);
+        stats_publish_cache(&ipc, worker_id, &cache_stats);
+        path_rate_t top_hits[TOPN_PUBLISH], top_bytes[TOPN_PUBLISH];
+        topn_collect(top_hits, top_bytes);
+        stats_publish_top(&ipc, worker_id, top_hits, top_bytes);
+        proc_stats_t proc;
+        perfstat_sample(stats_worker_requests(&ipc, worker_id), &proc);
+        mem_stats_t mem;
+        perfstat_heap(&mem);
+        mem.conn_buffers = http_buffer_bytes(config->threads_per_worker) + dashboard_stream_buffer_bytes();
+        mem.log_buffers = logger_buffer_bytes() + trace_buffer_bytes();
+        stats_publish_proc(&ipc, worker_id, &proc, &mem);
+
+        // Grava o snapshot periodicamente
+        if (use_snapshot && ++since_snapshot >= config->cache_snapshot_interval) {
+            cache_snapshot_save(local_cache, st.snapshot_path);
+            since_snapshot = 0;
+        }
+    }
 
     printf("[WORKER %d] Shutting down...\n", worker_id);
 
     // Cleanup
     thread_pool_shutdown(&pool);
+    if (warmup_started) pthread_join(warmup_thread, NULL);
+    if (use_snapshot) cache_snapshot_save(local_cache, st.snapshot_path);
+    dashboard_stream_cleanup();
+    trace_cleanup();
+    perfstat_cleanup();
+    topn_cleanup();
+    negcache_cleanup();
 
     if (local_cache) {
         cache_destroy(local_cache);
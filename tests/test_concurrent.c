@@ -5,6 +5,7 @@
 #include <curl/curl.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <sys/stat.h>
 
 #define SERVER_URL "http://localhost:8080"
 
@@ -163,10 +164,219 @@ void test_statistics_accuracy(void) {
     printf("  Expected: ~200 requests logged\n");
 }
 
+typedef struct {
+    char* data;
+    size_t len;
+} buffer_t;
+
+static size_t buffer_callback(void* contents, size_t size, size_t nmemb, void* userp) {
+    buffer_t* b = (buffer_t*)userp;
+    size_t n = size * nmemb;
+    char* p = realloc(b->data, b->len + n + 1);
+    if (!p) return 0;
+    b->data = p;
+    memcpy(b->data + b->len, contents, n);
+    b->len += n;
+    b->data[b->len] = '\0';
+    return n;
+}
+
+// Sums every worker's sample of a /metrics counter; *samples gets the number of workers
+static long metric_total(const char* name, int* samples) {
+    CURL* curl = curl_easy_init();
+    if (!curl) return -1;
+    buffer_t body = {0};
+    char url[256];
+    snprintf(url, sizeof(url), "%s/metrics", SERVER_URL);
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, buffer_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &body);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5L);
+    CURLcode res = curl_easy_perform(curl);
+    curl_easy_cleanup(curl);
+    if (res != CURLE_OK || !body.data) {
+        free(body.data);
+        return -1;
+    }
+
+    long total = 0;
+    *samples = 0;
+    size_t name_len = strlen(name);
+    for (char* line = strtok(body.data, "\n"); line; line = strtok(NULL, "\n")) {
+        if (strncmp(line, name, name_len) != 0 || line[name_len] != '{') continue;
+        char* value = strrchr(line, ' ');
+        if (value) {
+            total += atol(value + 1);
+            (*samples)++;
+        }
+    }
+    free(body.data);
+    return total;
+}
+
+typedef struct {
+    const char* url;
+    size_t expected;
+    int ok;
+} fetch_args_t;
+
+static void* fetch_thread(void* arg) {
+    fetch_args_t* a = (fetch_args_t*)arg;
+    CURL* curl = curl_easy_init();
+    if (!curl) return NULL;
+    buffer_t body = {0};
+    curl_easy_setopt(curl, CURLOPT_URL, a->url);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, buffer_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &body);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5L);
+    long http_code = 0;
+    if (curl_easy_perform(curl) == CURLE_OK)
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+    a->ok = (http_code == 200 && body.len == a->expected);
+    free(body.data);
+    curl_easy_cleanup(curl);
+    return NULL;
+}
+
+void test_coalesced_misses(void) {
+    printf("\n[TEST 21] Concurrent misses on one file are coalesced\n");
+    const char* file = "www/_coalesce.bin";
+    const size_t size = 200 * 1024;
+    const int num_threads = 64;
+
+    FILE* f = fopen(file, "wb");
+    if (!f) {
+        printf("  FAILED: cannot create %s (run from the repository root)\n", file);
+        tests_failed++;
+        tests_run++;
+        return;
+    }
+    for (size_t i = 0; i < size; i++) fputc('a' + i % 26, f);
+    fclose(f);
+    sleep(1);  // Let the docroot filter pick up the new file
+
+    int workers = 0;
+    long before = metric_total("http_cache_fills_total", &workers);
+
+    char url[256];
+    snprintf(url, sizeof(url), "%s/_coalesce.bin", SERVER_URL);
+    pthread_t threads[num_threads];
+    fetch_args_t args[num_threads];
+    for (int i = 0; i < num_threads; i++) {
+        args[i] = (fetch_args_t){ .url = url, .expected = size };
+        pthread_create(&threads[i], NULL, fetch_thread, &args[i]);
+    }
+    int complete = 0;
+    for (int i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+        complete += args[i].ok;
+    }
+
+    // /metrics is published by the master once per second
+    usleep(1500000);
+    int samples = 0;
+    long after = metric_total("http_cache_fills_total", &samples);
+    unlink(file);
+
+    printf("  %d/%d clients got the full %zu bytes\n", complete, num_threads, size);
+    printf("  Cache fills: %ld (at most one per worker, %d workers)\n", after - before, workers);
+    if (before >= 0 && after >= 0 && workers > 0 && complete == num_threads && after - before >= 1 &&
+        after - before <= workers) {
+        printf("  PASSED\n");
+        tests_passed++;
+    } else {
+        printf("  FAILED\n");
+        tests_failed++;
+    }
+    tests_run++;
+}
+
+#define RANGE_FILE_SIZE (3 * 1024 * 1024)
+
+// Position-dependent bytes, so a segment served at the wrong offset is detected
+static unsigned char pattern_byte(size_t i) {
+    return (unsigned char)((i * 31) ^ (i >> 12));
+}
+
+typedef struct {
+    unsigned int seed;
+    int requests, intact;
+} range_args_t;
+
+static void* range_thread(void* arg) {
+    range_args_t* a = (range_args_t*)arg;
+    CURL* curl = curl_easy_init();
+    if (!curl) return NULL;
+    for (int r = 0; r < a->requests; r++) {
+        // Random seeks, up to 600 KB long, so most of them cross a 256 KB segment boundary
+        size_t start = rand_r(&a->seed) % RANGE_FILE_SIZE;
+        size_t len = 1 + rand_r(&a->seed) % (600 * 1024);
+        if (start + len > RANGE_FILE_SIZE) len = RANGE_FILE_SIZE - start;
+        char range[64];
+        snprintf(range, sizeof(range), "%zu-%zu", start, start + len - 1);
+
+        buffer_t body = {0};
+        curl_easy_setopt(curl, CURLOPT_URL, SERVER_URL "/_ranges.bin");
+        curl_easy_setopt(curl, CURLOPT_RANGE, range);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, buffer_callback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &body);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5L);
+        long http_code = 0;
+        if (curl_easy_perform(curl) == CURLE_OK)
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+        int ok = http_code == 206 && body.len == len;
+        for (size_t i = 0; ok && i < len; i++) ok = (unsigned char)body.data[i] == pattern_byte(start + i);
+        a->intact += ok;
+        free(body.data);
+    }
+    curl_easy_cleanup(curl);
+    return NULL;
+}
+
+void test_concurrent_ranges(void) {
+    printf("\n[TEST 22] Concurrent ranges on a segmented file\n");
+    const char* file = "www/_ranges.bin";
+    const int num_threads = 16, requests = 20;
+
+    FILE* f = fopen(file, "wb");
+    if (!f) {
+        printf("  FAILED: cannot create %s (run from the repository root)\n", file);
+        tests_failed++;
+        tests_run++;
+        return;
+    }
+    for (size_t i = 0; i < RANGE_FILE_SIZE; i++) fputc(pattern_byte(i), f);
+    fclose(f);
+    sleep(1);  // Let the docroot filter pick up the new file
+
+    pthread_t threads[num_threads];
+    range_args_t args[num_threads];
+    for (int i = 0; i < num_threads; i++) {
+        args[i] = (range_args_t){ .seed = 1234u + i, .requests = requests };
+        pthread_create(&threads[i], NULL, range_thread, &args[i]);
+    }
+    int intact = 0;
+    for (int i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+        intact += args[i].intact;
+    }
+    unlink(file);
+
+    printf("  %d/%d ranges returned 206 with the right bytes\n", intact, num_threads * requests);
+    if (intact == num_threads * requests) {
+        printf("  PASSED\n");
+        tests_passed++;
+    } else {
+        printf("  FAILED\n");
+        tests_failed++;
+    }
+    tests_run++;
+}
+
 int main(void) {
     printf("================================================\n");
     printf("Concurrency Tests (Multi-threaded Load Testing)\n");
-    printf("Tests 5-8: Concurrent Request Handling\n");
+    printf("Tests 5-8, 21-22: Concurrent Request Handling\n");
     printf("================================================\n");
     
     if (!check_server()) {
@@ -180,6 +390,8 @@ int main(void) {
     test_no_dropped_connections();
     test_multiple_clients();
     test_statistics_accuracy();
+    test_coalesced_misses();
+    test_concurrent_ranges();
     
     printf("\n================================================\n");
     printf("CONCURRENCY TEST SUMMARY\n");
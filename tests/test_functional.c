@@ -3,6 +3,10 @@
 #include <string.h>
 #include <curl/curl.h>
 #include <sys/stat.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 
 #define SERVER_URL "http://localhost:8080"
 
@@ -183,10 +187,370 @@ void test_content_types(void) {
     }
 }
 
+typedef struct {
+    char* data;
+    size_t len;
+} buffer_t;
+
+static size_t buffer_callback(void* contents, size_t size, size_t nmemb, void* userp) {
+    buffer_t* b = (buffer_t*)userp;
+    size_t n = size * nmemb;
+    char* p = realloc(b->data, b->len + n + 1);
+    if (!p) return 0;
+    b->data = p;
+    memcpy(b->data + b->len, contents, n);
+    b->len += n;
+    b->data[b->len] = '\0';
+    return n;
+}
+
+// Keeps the Content-Range response header (empty if absent)
+static size_t content_range_callback(char* line, size_t size, size_t nmemb, void* userp) {
+    size_t n = size * nmemb;
+    if (n > 14 && strncasecmp(line, "Content-Range:", 14) == 0) {
+        size_t len = n - 14;
+        if (len > 127) len = 127;
+        memcpy(userp, line + 14, len);
+        ((char*)userp)[len] = '\0';
+        char* end = strpbrk(userp, "\r\n");
+        if (end) *end = '\0';
+    }
+    return n;
+}
+
+// GET with an optional "Range: bytes=<range>"; returns the status code
+static long fetch(const char* url, const char* range, buffer_t* body, char* content_range) {
+    CURL* curl = curl_easy_init();
+    if (!curl) return 0;
+    long status_code = 0;
+    body->data = NULL;
+    body->len = 0;
+    if (content_range) content_range[0] = '\0';
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, buffer_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, body);
+    if (range) curl_easy_setopt(curl, CURLOPT_RANGE, range);
+    if (content_range) {
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, content_range_callback);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, content_range);
+    }
+    if (curl_easy_perform(curl) == CURLE_OK) curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status_code);
+    curl_easy_cleanup(curl);
+    return status_code;
+}
+
+static void record(int ok, const char* what) {
+    if (ok) {
+        printf("  %s\n", what);
+        tests_passed++;
+    } else {
+        printf("  FAILED: %s\n", what);
+        tests_failed++;
+    }
+    tests_run++;
+}
+
+// Position-dependent bytes, so a segment served at the wrong offset is detected
+static unsigned char pattern_byte(size_t i) {
+    return (unsigned char)((i * 31) ^ (i >> 12));
+}
+
+void test_range_requests(void) {
+    printf("\n[TEST 16] Range requests on small and segmented files\n");
+
+    buffer_t body;
+    char content_range[128];
+    long status = fetch(SERVER_URL "/test.txt", "0-4", &body, content_range);
+    FILE* f = fopen("www/test.txt", "rb");
+    char head[5] = {0};
+    size_t got = f ? fread(head, 1, sizeof(head), f) : 0;
+    if (f) fclose(f);
+    record(status == 206 && body.len == 5 && got == 5 && memcmp(body.data, head, 5) == 0,
+           "bytes=0-4 of a small file -> 206 with the first 5 bytes");
+    free(body.data);
+
+    // Above CACHE_MAX_OBJECT_KB (1 MB), so served through 256 KB cached segments
+    const char* file = "www/_range.bin";
+    const size_t size = 3 * 1024 * 1024;
+    f = fopen(file, "wb");
+    if (!f) {
+        record(0, "create www/_range.bin (run from the repository root)");
+        return;
+    }
+    for (size_t i = 0; i < size; i++) fputc(pattern_byte(i), f);
+    fclose(f);
+    sleep(1);  // Let the docroot filter pick up the new file
+
+    struct {
+        const char* range;
+        size_t start, len;
+        const char* what;
+    } cases[] = {
+        {"262140-262150", 262140, 11, "bytes=262140-262150 crosses the first segment boundary"},
+        {"1048000-1600000", 1048000, 552001, "bytes=1048000-1600000 spans three segments"},
+        {"262140-262150", 262140, 11, "the same range again, now from cached segments"},
+        {"-1000", size - 1000, 1000, "bytes=-1000 returns the last 1000 bytes"},
+        {"3145000-", 3145000, size - 3145000, "bytes=3145000- runs to the end of the file"},
+        {"3000000-9999999", 3000000, size - 3000000, "an end past EOF is clamped to the file size"},
+    };
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        status = fetch(SERVER_URL "/_range.bin", cases[c].range, &body, content_range);
+        int ok = status == 206 && body.len == cases[c].len;
+        for (size_t i = 0; ok && i < body.len; i++) ok = (unsigned char)body.data[i] == pattern_byte(cases[c].start + i);
+        char expected[128];
+        snprintf(expected, sizeof(expected), " bytes %zu-%zu/%zu", cases[c].start, cases[c].start + cases[c].len - 1, size);
+        ok = ok && strcmp(content_range, expected) == 0;
+        record(ok, cases[c].what);
+        free(body.data);
+    }
+
+    status = fetch(SERVER_URL "/_range.bin", "3145728-", &body, content_range);
+    record(status == 416 && strcmp(content_range, " bytes */3145728") == 0,
+           "a range starting at EOF -> 416 with Content-Range: bytes */3145728");
+    free(body.data);
+
+    status = fetch(SERVER_URL "/_range.bin", NULL, &body, NULL);
+    int whole = status == 200 && body.len == size;
+    for (size_t i = 0; whole && i < body.len; i++) whole = (unsigned char)body.data[i] == pattern_byte(i);
+    record(whole, "the whole file without Range -> 200 with every byte in place");
+    free(body.data);
+
+    unlink(file);
+}
+
+void test_negative_cache(void) {
+    printf("\n[TEST 17] Missing files: repeated 404s, then creation and deletion\n");
+    const char* file = "www/_negcache.txt";
+    const char* url = SERVER_URL "/_negcache.txt";
+    unlink(file);
+
+    // Spread over several workers, so each one remembers the path as missing
+    int all_404 = 1;
+    buffer_t body;
+    for (int i = 0; i < 20; i++) {
+        long status = fetch(url, NULL, &body, NULL);
+        all_404 &= status == 404 && body.len > 0;
+        free(body.data);
+    }
+    record(all_404, "20 requests for a missing file -> 404 with the error page");
+
+    FILE* f = fopen(file, "w");
+    if (!f) {
+        record(0, "create www/_negcache.txt (run from the repository root)");
+        return;
+    }
+    fputs("now it exists\n", f);
+    fclose(f);
+    // Never requested while it exists, so it is not held by any worker's cache
+    f = fopen("www/_negcache_gone.txt", "w");
+    if (f) fclose(f);
+    // Well inside NEGATIVE_CACHE_TTL (5 s): only the inotify rebuild can make it visible
+    sleep(1);
+    int all_200 = 1;
+    for (int i = 0; i < 20; i++) {
+        long status = fetch(url, NULL, &body, NULL);
+        all_200 &= status == 200 && body.len == 14 && memcmp(body.data, "now it exists\n", 14) == 0;
+        free(body.data);
+    }
+    record(all_200, "a file created after the 404s is served on every worker within 1 s");
+
+    unlink(file);
+    unlink("www/_negcache_gone.txt");
+    sleep(1);
+    int gone = 1;
+    for (int i = 0; i < 20; i++) {
+        long status = fetch(SERVER_URL "/_negcache_gone.txt", NULL, &body, NULL);
+        gone &= status == 404;
+        free(body.data);
+    }
+    record(gone, "a file deleted after the filter rebuild is 404");
+}
+
+// Value of an unlabelled sample ("name value") in a Prometheus text body, -1 if absent
+static double metric_value(const char* text, const char* name) {
+    size_t len = strlen(name);
+    const char* line = text;
+    while (line) {
+        if (strncmp(line, name, len) == 0 && line[len] == ' ') return atof(line + len + 1);
+        line = strchr(line, '\n');
+        if (line) line++;
+    }
+    return -1;
+}
+
+// Every line is a comment, a blank line or "name[{labels}] value"
+static int well_formed_exposition(const char* text) {
+    char line[1024];
+    for (const char* p = text; *p; ) {
+        const char* nl = strchr(p, '\n');
+        size_t len = nl ? (size_t)(nl - p) : strlen(p);
+        if (len >= sizeof(line)) return 0;
+        memcpy(line, p, len);
+        line[len] = '\0';
+        p += len + (nl ? 1 : 0);
+        if (len == 0 || line[0] == '#') continue;
+
+        char* value = strrchr(line, ' ');
+        if (!value || value == line) return 0;
+        char* end;
+        strtod(value + 1, &end);
+        if (*end != '\0') return 0;
+        for (char* c = line; c < value && *c != '{'; c++) {
+            if (!(*c == '_' || (*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9'))) return 0;
+        }
+    }
+    return 1;
+}
+
+void test_metrics(void) {
+    printf("\n[TEST 18] Prometheus /metrics endpoint\n");
+
+    buffer_t body;
+    long status = fetch(SERVER_URL "/metrics", NULL, &body, NULL);
+    char* ct = get_content_type(SERVER_URL "/metrics");
+    record(status == 200 && ct && strncmp(ct, "text/plain; version=0.0.4", 25) == 0,
+           "GET /metrics -> 200 text/plain; version=0.0.4");
+    record(body.data && strstr(body.data, "# TYPE http_requests_total counter\n") &&
+           strstr(body.data, "# TYPE http_cache_fills_total counter\n"),
+           "exposes http_requests_total and the per-worker cache counters");
+    record(body.data && well_formed_exposition(body.data), "every sample line is \"name{labels} value\"");
+    double before = body.data ? metric_value(body.data, "http_requests_total") : -1;
+    free(body.data);
+
+    for (int i = 0; i < 20; i++) get_http_status(SERVER_URL "/index.html", 0);
+    // The master publishes the snapshot served by /metrics once per second
+    sleep(2);
+    status = fetch(SERVER_URL "/metrics", NULL, &body, NULL);
+    double after = body.data ? metric_value(body.data, "http_requests_total") : -1;
+    free(body.data);
+    printf("  http_requests_total: %.0f -> %.0f\n", before, after);
+    record(before >= 0 && after >= before + 20, "http_requests_total counts the 20 requests within 2 s");
+}
+
+// Braces and brackets balance outside of strings: catches a truncated or spliced document
+static int balanced_json(const char* text) {
+    int depth = 0, in_string = 0;
+    for (const char* c = text; *c; c++) {
+        if (in_string) {
+            if (*c == '\\' && c[1]) c++;
+            else if (*c == '"') in_string = 0;
+        } else if (*c == '"') {
+            in_string = 1;
+        } else if (*c == '{' || *c == '[') {
+            depth++;
+        } else if (*c == '}' || *c == ']') {
+            if (--depth < 0) return 0;
+        }
+    }
+    return depth == 0 && !in_string;
+}
+
+static int count_events(const buffer_t* b) {
+    int events = 0;
+    for (const char* p = b->data; p && (p = strstr(p, "\n\n")) != NULL; p += 2) events++;
+    return events;
+}
+
+// Keeps the stream open only until two events have arrived
+static size_t stream_callback(void* contents, size_t size, size_t nmemb, void* userp) {
+    size_t n = buffer_callback(contents, size, nmemb, userp);
+    return count_events((buffer_t*)userp) >= 2 ? 0 : n;
+}
+
+void test_stats_json(void) {
+    printf("\n[TEST 19] Dashboard data: /stats.json and /stats/stream\n");
+
+    buffer_t body;
+    long status = fetch(SERVER_URL "/stats.json", NULL, &body, NULL);
+    char* ct = get_content_type(SERVER_URL "/stats.json");
+    record(status == 200 && ct && strstr(ct, "application/json"), "GET /stats.json -> 200 application/json");
+    record(body.data && body.data[0] == '{' && body.data[body.len - 1] == '}' && balanced_json(body.data),
+           "the document is one complete JSON object");
+    record(body.data && strstr(body.data, "\"workers\":[{") && !strstr(body.data, "\"truncated\""),
+           "it carries the per-worker sections without truncation");
+    free(body.data);
+
+    CURL* curl = curl_easy_init();
+    if (!curl) return;
+    buffer_t stream = {0};
+    curl_easy_setopt(curl, CURLOPT_URL, SERVER_URL "/stats/stream");
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, stream_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &stream);
+    curl_easy_perform(curl);  // Ends with a write error once the callback has two events
+    ct = NULL;
+    curl_easy_getinfo(curl, CURLINFO_CONTENT_TYPE, &ct);
+    record(ct && strstr(ct, "text/event-stream"), "GET /stats/stream -> text/event-stream");
+
+    int events = count_events(&stream);
+    int ok = events >= 2 && strncmp(stream.data, "data: {", 7) == 0;
+    char* first_end = stream.data ? strstr(stream.data, "\n\n") : NULL;
+    ok = ok && strncmp(first_end + 2, "data: {", 7) == 0;
+    if (ok) {
+        // Each event is a single data line holding a whole snapshot
+        *first_end = '\0';
+        ok = balanced_json(stream.data + 6) && strchr(stream.data, '\n') == NULL;
+    }
+    record(ok, "the stream pushes a first snapshot and then another one, each a full JSON event");
+    free(stream.data);
+    curl_easy_cleanup(curl);
+}
+
+// Connects, then waits before sending the request: the time goes into the recv stage
+static int slow_request(const char* path, int delay_ms) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(8080) };
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    usleep(delay_ms * 1000);
+    char request[256];
+    int len = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: localhost\r\n\r\n", path);
+    char reply[4096];
+    int ok = send(fd, request, len, 0) == len && recv(fd, reply, sizeof(reply), 0) > 0;
+    close(fd);
+    return ok ? 0 : -1;
+}
+
+void test_debug_slow(void) {
+    printf("\n[TEST 20] Slow request log at /debug/slow\n");
+
+    buffer_t body;
+    long status = fetch(SERVER_URL "/debug/slow", NULL, &body, NULL);
+    char* ct = get_content_type(SERVER_URL "/debug/slow");
+    record(status == 200 && ct && strstr(ct, "text/plain") && body.data && strncmp(body.data, "# ", 2) == 0,
+           "GET /debug/slow -> 200 text/plain starting with the summary line");
+    free(body.data);
+
+    // Above SLOW_REQUEST_MS (100 ms in server.conf)
+    char path[64];
+    snprintf(path, sizeof(path), "/_slow_probe_%d.html", (int)getpid());
+    if (slow_request(path, 250) != 0) {
+        record(0, "send a request 250 ms after connecting");
+        return;
+    }
+    status = fetch(SERVER_URL "/debug/slow", NULL, &body, NULL);
+    char* line = body.data ? strstr(body.data, path) : NULL;
+    while (line && line > body.data && line[-1] != '\n') line--;
+    double ms = 0;
+    char* ms_field = line ? strstr(line, "ms cpu=") : NULL;
+    if (ms_field) {
+        while (ms_field > line && ms_field[-1] != ' ') ms_field--;
+        ms = atof(ms_field);
+    }
+    record(line && ms >= 250 && strstr(line, " 404 ") && strstr(line, " recv="),
+           "a request that took 250 ms is listed with its status, total time and stages");
+    free(body.data);
+}
+
 int main(void) {
     printf("================================================\n");
     printf("Functional Tests (HTTP Protocol & File Serving)\n");
-    printf("Tests 1-4: Basic HTTP Functionality\n");
+    printf("Tests 1-4, 16-20: Basic HTTP Functionality\n");
     printf("================================================\n");
     
     if (!check_server()) {
@@ -200,6 +564,11 @@ int main(void) {
     test_status_codes();
     test_directory_index();
     test_content_types();
+    test_range_requests();
+    test_negative_cache();
+    test_metrics();
+    test_stats_json();
+    test_debug_slow();
     
     printf("\n================================================\n");
     printf("FUNCTIONAL TEST SUMMARY\n");
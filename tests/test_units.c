@@ -0,0 +1,659 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "histogram.h"
+#include "slab.h"
+#include "topn.h"
+// White-box: the frequency sketch and the eviction policies are static inside cache.c
+#include "cache.c"
+
+int tests_run = 0, tests_passed = 0, tests_failed = 0;
+
+// Each check counts as one test, like the HTTP checks in the other suites
+static void check(int ok, const char* what) {
+    if (ok) {
+        printf("  %s\n", what);
+        tests_passed++;
+    } else {
+        printf("  FAILED: %s\n", what);
+        tests_failed++;
+    }
+    tests_run++;
+}
+
+void test_histogram(void) {
+    printf("\n[TEST 23] Histogram bucket math and percentiles\n");
+
+    // Below 2 * HIST_SUB every value has its own bucket
+    int exact = 1;
+    for (uint64_t v = 0; v < 2 * HIST_SUB; v++) {
+        hist_t h;
+        memset(&h, 0, sizeof(h));
+        hist_record(&h, v);
+        hist_record(&h, 1000000);
+        if (hist_percentile(&h, 50) != v || h.buckets[v] != 1) exact = 0;
+    }
+    check(exact, "values below 32 us are recorded exactly");
+
+    // Above that, the reported value is the bucket's upper bound: never below, < 1/16 above
+    int bounded = 1;
+    for (uint64_t v = 2 * HIST_SUB; v < (1ULL << HIST_MAX_BITS); v = v * 5 / 4 + 1) {
+        hist_t h;
+        memset(&h, 0, sizeof(h));
+        hist_record(&h, v);
+        hist_record(&h, 1ULL << HIST_MAX_BITS);
+        uint64_t p = hist_percentile(&h, 50);
+        if (p < v || (double)(p - v) / v >= 1.0 / HIST_SUB) {
+            printf("    %lu reported as %lu\n", v, p);
+            bounded = 0;
+        }
+        if (hist_count_le(&h, p) != 1 || hist_count_le(&h, v - 1) != 0) bounded = 0;
+    }
+    check(bounded, "larger values land in a bucket within 6.25% above them");
+
+    hist_t huge;
+    memset(&huge, 0, sizeof(huge));
+    hist_record(&huge, 1ULL << 40);
+    check(huge.buckets[HIST_BUCKETS - 1] == 1 && hist_percentile(&huge, 99) == (1ULL << HIST_MAX_BITS) - 1 &&
+          huge.max_us == (1ULL << 40), "values past the last bucket are clamped to it, max is kept exactly");
+
+    hist_t empty;
+    memset(&empty, 0, sizeof(empty));
+    check(hist_percentile(&empty, 99) == 0 && hist_count_le(&empty, 1000) == 0, "empty histogram reports 0");
+
+    // 1..10000 uniform: percentiles within the bucket error of the true value
+    hist_t all, low, high, diff;
+    memset(&all, 0, sizeof(all));
+    memset(&low, 0, sizeof(low));
+    memset(&high, 0, sizeof(high));
+    for (uint64_t v = 1; v <= 10000; v++) {
+        hist_record(&all, v);
+        hist_record(v <= 5000 ? &low : &high, v);
+    }
+    const double ps[] = { 50, 90, 99, 99.9 };
+    int accurate = 1;
+    for (size_t i = 0; i < sizeof(ps) / sizeof(ps[0]); i++) {
+        double want = ps[i] * 100;
+        uint64_t got = hist_percentile(&all, ps[i]);
+        if (got < want || (got - want) / want >= 1.0 / HIST_SUB) {
+            printf("    p%g = %lu (expected ~%.0f)\n", ps[i], got, want);
+            accurate = 0;
+        }
+    }
+    check(accurate && hist_percentile(&all, 100) == 10000, "p50/p90/p99/p99.9 of 1..10000 within bucket error");
+    check(hist_count_le(&all, 0) == 0 && hist_count_le(&all, 31) == 31 && hist_count_le(&all, UINT64_MAX) == 10000,
+          "cumulative counts for exported le buckets");
+
+    // Per-thread histograms add up; a later snapshot minus an earlier one is the window
+    hist_t merged = low;
+    hist_merge(&merged, &high);
+    check(memcmp(merged.buckets, all.buckets, sizeof(all.buckets)) == 0 && merged.count == all.count &&
+          merged.sum_us == all.sum_us && merged.max_us == all.max_us, "merge of two halves equals the whole");
+
+    hist_diff(&diff, &all, &low);
+    check(memcmp(diff.buckets, high.buckets, sizeof(high.buckets)) == 0 && diff.count == high.count &&
+          diff.sum_us == high.sum_us && diff.max_us == 10000, "diff of snapshots recovers the newer half");
+}
+
+void test_slab(void) {
+    printf("\n[TEST 24] Slab arena size classes and page reuse\n");
+
+    const size_t page = 64 * 1024;
+    slab_arena_t* a = slab_init(16 * page, 0);
+    if (!a) {
+        check(0, "slab_init of a 1 MB arena");
+        return;
+    }
+
+    // Small classes: 16-byte aligned, growing by ~25%, so rounding never wastes more than that
+    int classes_ok = 1;
+    size_t prev = 0;
+    for (size_t size = 1; size <= page / 2; size++) {
+        size_t chunk = slab_chunk_size(a, size);
+        if (chunk < size || chunk % 16 != 0 || chunk < prev || (size > 64 && chunk > size + size / 4 + 16)) {
+            printf("    %zu bytes -> chunk %zu\n", size, chunk);
+            classes_ok = 0;
+            break;
+        }
+        prev = chunk;
+    }
+    check(classes_ok, "every small size maps to an aligned class at most ~25% larger");
+    check(slab_chunk_size(a, page / 2 + 1) == page && slab_chunk_size(a, 3 * page - 1) == 3 * page,
+          "large objects take whole 64 KB pages");
+    check(slab_chunk_size(a, 16 * page + 1) == 0, "objects bigger than the arena report 0 (never fit)");
+
+    // Chunks of one class are distinct and accounted at their class size
+    void* chunks[100];
+    int distinct = 1;
+    for (int i = 0; i < 100; i++) {
+        chunks[i] = slab_alloc(a, 100);
+        if (!chunks[i]) distinct = 0;
+        else memset(chunks[i], i, 100);
+    }
+    for (int i = 0; i < 100 && distinct; i++) {
+        for (int k = 0; k < 100; k++) if (((unsigned char*)chunks[i])[k] != i) distinct = 0;
+    }
+    check(distinct && slab_used(a) == 100 * slab_chunk_size(a, 100), "100 small chunks are distinct and counted");
+
+    for (int i = 0; i < 100; i++) slab_free(a, chunks[i]);
+    check(slab_used(a) == 0, "freeing every chunk returns the usage to 0");
+
+    // Emptied pages go back to the free pool: the whole arena fits one large object again
+    void* whole = slab_alloc(a, 16 * page);
+    check(whole != NULL && slab_alloc(a, 1) == NULL, "empty pages are reusable by another class, then the arena is full");
+    slab_free(a, whole);
+
+    int pages = 0;
+    void* big[17];
+    while (pages < 17 && (big[pages] = slab_alloc(a, page)) != NULL) pages++;
+    int refill = pages == 16;
+    if (pages > 0) {
+        slab_free(a, big[pages / 2]);
+        refill = refill && slab_alloc(a, page) == big[pages / 2];
+    }
+    check(refill, "exactly 16 one-page objects fit, a freed page is handed out again");
+
+    // Eviction planning: asks whether freeing some blocks would serve a request, without freeing them
+    if (pages == 16) {
+        void* adjacent[] = { big[3], big[4] };
+        void* apart[] = { big[3], big[5] };
+        check(slab_fits_after_free(a, 2 * page, adjacent, 2) && !slab_fits_after_free(a, 2 * page, apart, 2) &&
+              slab_fits_after_free(a, 100, apart, 1) && slab_used(a) == 16 * page,
+              "slab_fits_after_free needs a contiguous run and leaves the arena untouched");
+    }
+
+    slab_destroy(a);
+}
+
+// Cache with only the fields the policies look at; everything else off
+static cache_t* small_cache(int size_mb, int admission, int policy) {
+    server_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.cache_size_mb = size_mb;
+    config.cache_admission = admission;
+    config.cache_policy = policy;
+    config.cache_max_object_kb = 1024;
+    return cache_init(&config);
+}
+
+// Miss recorded in the sketch (as cache_acquire does), then the insert
+static void miss_and_put(cache_t* cache, const char* key, size_t size) {
+    static char body[512 * 1024];
+    cache_release(cache_get(cache, key));
+    cache_put(cache, key, body, size);
+}
+
+static int cached(cache_t* cache, const char* key) {
+    cache_entry_t* e = cache_get(cache, key);
+    cache_release(e);
+    return e != NULL;
+}
+
+void test_sketch(void) {
+    printf("\n[TEST 25] Frequency sketch saturation and aging\n");
+
+    freq_sketch_t sk;
+    if (sketch_init(&sk, 0) != 0) {
+        check(0, "sketch_init");
+        return;
+    }
+    const uint64_t key = 0x9e3779b97f4a7c15ULL;
+    for (int i = 0; i < 100; i++) sketch_increment(&sk, key);
+    check(sketch_frequency(&sk, key) == SKETCH_MAX_COUNT, "counters saturate at 15");
+    check(sk.additions == SKETCH_MAX_COUNT, "increments on saturated counters do not count towards aging");
+    check(sketch_frequency(&sk, 0x1234567890abcdefULL) == 0, "an unseen key has frequency 0");
+
+    sketch_age(&sk);
+    check(sketch_frequency(&sk, key) == SKETCH_MAX_COUNT / 2, "aging halves every counter");
+
+    // Aging fires on its own once sample_size additions are reached
+    memset(sk.table, 0, (size_t)SKETCH_DEPTH * (sk.width_mask + 1));
+    sk.additions = 0;
+    sk.sample_size = 10;
+    for (int i = 0; i < 10; i++) sketch_increment(&sk, key);
+    check(sketch_frequency(&sk, key) == 5 && sk.additions == 5, "reaching sample_size additions ages the sketch");
+    free(sk.table);
+}
+
+void test_tinylfu(void) {
+    printf("\n[TEST 26] W-TinyLFU admission resists a one-hit scan\n");
+
+    const int hot = 110;         // 110 x 8 KB: more than the SLRU protected zone (~80% of 1 MB)
+    const int scan = 1000;       // 8 MB of objects requested once each
+    int kept[2] = { 0, 0 };
+    const int admissions[2] = { CACHE_ADMISSION_NONE, CACHE_ADMISSION_TINYLFU };
+    for (int m = 0; m < 2; m++) {
+        cache_t* cache = small_cache(1, admissions[m], CACHE_POLICY_SLRU);
+        if (!cache) {
+            check(0, "cache_init");
+            return;
+        }
+        char key[64];
+        for (int i = 0; i < hot; i++) {
+            snprintf(key, sizeof(key), "/hot%d", i);
+            miss_and_put(cache, key, 8192);
+        }
+        for (int round = 0; round < 5; round++) {
+            for (int i = 0; i < hot; i++) {
+                snprintf(key, sizeof(key), "/hot%d", i);
+                cached(cache, key);
+            }
+        }
+        for (int i = 0; i < scan; i++) {
+            snprintf(key, sizeof(key), "/scan%d", i);
+            miss_and_put(cache, key, 8192);
+        }
+        for (int i = 0; i < hot; i++) {
+            snprintf(key, sizeof(key), "/hot%d", i);
+            kept[m] += cached(cache, key);
+        }
+        cache_destroy(cache);
+    }
+    printf("    hot objects kept after the scan: %d/%d without admission, %d/%d with TinyLFU\n",
+           kept[0], hot, kept[1], hot);
+    check(kept[1] >= hot * 9 / 10, "TinyLFU keeps at least 90% of the hot set");
+    check(kept[1] > kept[0], "plain LRU admission loses more of the hot set");
+}
+
+static cache_t* arena_cache(void) {
+    server_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.cache_size_mb = 1;
+    config.cache_max_object_kb = 1024;
+    config.cache_arena = 1;
+    return cache_init(&config);
+}
+
+void test_arena_eviction(void) {
+    printf("\n[TEST 32] Arena evictions are planned before anything leaves\n");
+
+    // Small entries pack every page: a 5-page object would need hundreds of evictions
+    cache_t* cache = arena_cache();
+    if (!cache) {
+        check(0, "cache_init with CACHE_ARENA");
+        return;
+    }
+    char key[64];
+    for (int i = 0; i < 10000; i++) {
+        snprintf(key, sizeof(key), "/small%d", i);
+        miss_and_put(cache, key, 100);
+    }
+    cache_stats_t before, after;
+    cache_get_stats(cache, &before);
+    miss_and_put(cache, "/large", 300 * 1024);
+    cache_get_stats(cache, &after);
+    check(!cached(cache, "/large") && after.evictions_capacity == before.evictions_capacity &&
+          after.entries == before.entries,
+          "an object no eviction budget can place is refused without evicting anything");
+    cache_destroy(cache);
+
+    // One-page entries: the two oldest are adjacent, so a 2-page object costs exactly those
+    cache = arena_cache();
+    if (!cache) return;
+    for (int i = 0; i < 16; i++) {
+        snprintf(key, sizeof(key), "/page%d", i);
+        miss_and_put(cache, key, 60 * 1024);
+    }
+    cache_get_stats(cache, &before);
+    miss_and_put(cache, "/double", 120 * 1024);
+    cache_get_stats(cache, &after);
+    printf("  evictions for a 2-page object: %lu\n", after.evictions_capacity - before.evictions_capacity);
+    check(cached(cache, "/double") && after.evictions_capacity - before.evictions_capacity <= 2,
+          "a feasible object evicts only the victims that free its pages");
+    cache_destroy(cache);
+}
+
+void test_gdsf(void) {
+    printf("\n[TEST 27] GDSF keeps small popular objects over large cold ones\n");
+
+    cache_t* cache = small_cache(1, CACHE_ADMISSION_NONE, CACHE_POLICY_GDSF);
+    if (!cache) {
+        check(0, "cache_init");
+        return;
+    }
+    char key[64];
+    for (int i = 0; i < 64; i++) {
+        snprintf(key, sizeof(key), "/small%d", i);
+        miss_and_put(cache, key, 4096);
+        for (int hit = 0; hit < 4; hit++) cached(cache, key);
+    }
+    // Each large object needs room: the victims must be the other large ones
+    for (int i = 0; i < 8; i++) {
+        snprintf(key, sizeof(key), "/large%d", i);
+        miss_and_put(cache, key, 256 * 1024);
+    }
+    int small = 0, large = 0;
+    for (int i = 0; i < 64; i++) {
+        snprintf(key, sizeof(key), "/small%d", i);
+        small += cached(cache, key);
+    }
+    for (int i = 0; i < 8; i++) {
+        snprintf(key, sizeof(key), "/large%d", i);
+        large += cached(cache, key);
+    }
+    printf("    kept %d/64 small and %d/8 large objects\n", small, large);
+    check(small == 64, "every small object with hits survives");
+    check(large >= 1 && large < 8, "large objects only displace each other");
+    cache_destroy(cache);
+
+    // With TinyLFU, a cold candidate that loses to its victims is refused before anything is evicted
+    cache = small_cache(1, CACHE_ADMISSION_TINYLFU, CACHE_POLICY_GDSF);
+    if (!cache) {
+        check(0, "cache_init");
+        return;
+    }
+    for (int i = 0; i < 200; i++) {
+        snprintf(key, sizeof(key), "/small%d", i);
+        miss_and_put(cache, key, 4096);
+        for (int hit = 0; hit < 4; hit++) cached(cache, key);
+    }
+    cache_stats_t before, after;
+    cache_get_stats(cache, &before);
+    miss_and_put(cache, "/cold", 512 * 1024);
+    cache_get_stats(cache, &after);
+    check(!cached(cache, "/cold") && after.evictions_capacity == before.evictions_capacity &&
+          after.entries == before.entries, "a refused candidate evicts nothing");
+    cache_destroy(cache);
+}
+
+typedef struct {
+    cache_t* cache;
+    const char* key;
+    int returned;        // Set once cache_acquire came back
+    int got_fill;        // This thread became a second leader (must not happen)
+    char first;          // First byte of the entry it got (0 if none)
+} waiter_t;
+
+static void* acquire_thread(void* arg) {
+    waiter_t* w = (waiter_t*)arg;
+    cache_fill_t* fill = NULL;
+    cache_entry_t* e = cache_acquire(w->cache, w->key, &fill);
+    if (fill) {
+        w->got_fill = 1;
+        cache_fill_abort(w->cache, fill);
+    }
+    if (e) w->first = *(char*)cache_entry_get_data(e);
+    cache_release(e);
+    __atomic_store_n(&w->returned, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+// Leader misses, 4 threads miss on the same key while it "reads the file"
+static int coalesce(cache_t* cache, const char* key, int complete, waiter_t* w, int* early) {
+    cache_fill_t* fill = NULL;
+    cache_entry_t* e = cache_acquire(cache, key, &fill);
+    if (e || !fill) {
+        cache_release(e);
+        return -1;
+    }
+    pthread_t threads[4];
+    for (int i = 0; i < 4; i++) {
+        memset(&w[i], 0, sizeof(w[i]));
+        w[i].cache = cache;
+        w[i].key = key;
+        pthread_create(&threads[i], NULL, acquire_thread, &w[i]);
+    }
+    usleep(100000);
+    *early = 0;
+    for (int i = 0; i < 4; i++) *early += __atomic_load_n(&w[i].returned, __ATOMIC_ACQUIRE);
+
+    if (complete) {
+        char body[4096];
+        memset(body, 'Z', sizeof(body));
+        cache_release(cache_fill_complete(cache, fill, body, sizeof(body)));
+    } else {
+        cache_fill_abort(cache, fill);
+    }
+    for (int i = 0; i < 4; i++) pthread_join(threads[i], NULL);
+    return 0;
+}
+
+void test_single_flight(void) {
+    printf("\n[TEST 28] Single-flight fills for concurrent misses\n");
+
+    cache_t* cache = small_cache(1, CACHE_ADMISSION_NONE, CACHE_POLICY_SLRU);
+    if (!cache) {
+        check(0, "cache_init");
+        return;
+    }
+    waiter_t w[4];
+    int early = 0;
+    if (coalesce(cache, "/shared", 1, w, &early) != 0) {
+        check(0, "first miss makes the caller the leader");
+        cache_destroy(cache);
+        return;
+    }
+    int all_got = 1;
+    for (int i = 0; i < 4; i++) all_got &= !w[i].got_fill && w[i].first == 'Z';
+    cache_stats_t st;
+    cache_get_stats(cache, &st);
+    check(early == 0, "followers wait for the leader instead of reading the file");
+    check(all_got, "every follower gets the leader's entry");
+    check(st.fills == 1, "one fill for five concurrent misses");
+
+    if (coalesce(cache, "/broken", 0, w, &early) != 0) {
+        check(0, "miss on a second key");
+        cache_destroy(cache);
+        return;
+    }
+    int none = 1;
+    for (int i = 0; i < 4; i++) none &= !w[i].got_fill && w[i].first == 0;
+    check(early == 0 && none, "an aborted fill wakes the followers with no entry");
+    cache_destroy(cache);
+}
+
+// Acquire/release via the L1 of this thread; returns the first byte or 0 on a miss
+static char l1_read(cache_t* cache, const char* key) {
+    cache_fill_t* fill = NULL;
+    cache_entry_t* e = cache_acquire(cache, key, &fill);
+    if (fill) cache_fill_abort(cache, fill);
+    char c = e ? *(char*)cache_entry_get_data(e) : 0;
+    cache_release(e);
+    return c;
+}
+
+void test_l1_invalidation(void) {
+    printf("\n[TEST 29] Per-thread L1 never serves a replaced or evicted entry\n");
+
+    server_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.cache_size_mb = 1;
+    config.cache_max_object_kb = 1024;
+    config.cache_l1_slots = 8;
+    cache_t* cache = cache_init(&config);
+    if (!cache) {
+        check(0, "cache_init");
+        return;
+    }
+
+    char old_body[1024], new_body[1024];
+    memset(old_body, 'A', sizeof(old_body));
+    memset(new_body, 'B', sizeof(new_body));
+    cache_put(cache, "/hot", old_body, sizeof(old_body));
+
+    int served_old = 1;
+    for (int i = 0; i < 10; i++) served_old &= l1_read(cache, "/hot") == 'A';
+    cached(cache, "/other");  // L1 hits are folded into the counters on the next shared lookup
+    cache_stats_t st;
+    cache_get_stats(cache, &st);
+    check(served_old && st.l1_hits > 0, "repeated reads are served from the L1");
+
+    // A reader still holding the old entry keeps valid data after the replacement
+    cache_fill_t* fill = NULL;
+    cache_entry_t* held = cache_acquire(cache, "/hot", &fill);
+    cache_put(cache, "/hot", new_body, sizeof(new_body));
+    check(held && *(char*)cache_entry_get_data(held) == 'A', "a borrowed entry stays readable after cache_put");
+    cache_release(held);
+
+    int served_new = 1;
+    for (int i = 0; i < 10; i++) served_new &= l1_read(cache, "/hot") == 'B';
+    check(served_new, "the next reads see the replacement, never the L1 copy");
+
+    cache_set_capacity(cache, 0);
+    check(l1_read(cache, "/hot") == 0, "an evicted entry is a miss even though the L1 still points at it");
+
+    cache_destroy(cache);
+}
+
+#define SEQ_WORDS 64
+#define SEQ_WRITES 5000
+
+typedef struct {
+    uint32_t seq;
+    uint64_t words[SEQ_WORDS];   // A consistent snapshot has every word equal
+} seq_block_t;
+
+static seq_block_t seq_block;
+static int seq_writer_done;
+
+static void* seq_writer(void* arg) {
+    (void)arg;
+    for (uint64_t i = 1; i <= SEQ_WRITES; i++) {
+        seq_write_begin(&seq_block.seq);
+        for (int k = 0; k < SEQ_WORDS; k++) __atomic_store_n(&seq_block.words[k], i, __ATOMIC_RELAXED);
+        seq_write_end(&seq_block.seq);
+        usleep(20);  // Readers give up after SEQ_MAX_RETRIES, so leave them gaps as a real writer does
+    }
+    __atomic_store_n(&seq_writer_done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+typedef struct {
+    long reads, torn, versions;
+} seq_reader_t;
+
+static void* seq_reader(void* arg) {
+    seq_reader_t* r = (seq_reader_t*)arg;
+    uint64_t last = 0;
+    while (!__atomic_load_n(&seq_writer_done, __ATOMIC_ACQUIRE)) {
+        seq_block_t copy;
+        seq_read(&seq_block.seq, copy.words, seq_block.words, sizeof(copy.words));
+        r->reads++;
+        for (int k = 1; k < SEQ_WORDS; k++) {
+            if (copy.words[k] != copy.words[0]) {
+                r->torn++;
+                break;
+            }
+        }
+        if (copy.words[0] != last) {
+            r->versions++;
+            last = copy.words[0];
+        }
+    }
+    return NULL;
+}
+
+void test_seqlock(void) {
+    printf("\n[TEST 30] Seqlock readers never see a half-written snapshot\n");
+
+    memset(&seq_block, 0, sizeof(seq_block));
+    seq_writer_done = 0;
+    pthread_t writer, readers[3];
+    seq_reader_t results[3];
+    memset(results, 0, sizeof(results));
+    for (int i = 0; i < 3; i++) pthread_create(&readers[i], NULL, seq_reader, &results[i]);
+    pthread_create(&writer, NULL, seq_writer, NULL);
+    pthread_join(writer, NULL);
+
+    long reads = 0, torn = 0, versions = 0;
+    for (int i = 0; i < 3; i++) {
+        pthread_join(readers[i], NULL);
+        reads += results[i].reads;
+        torn += results[i].torn;
+        versions += results[i].versions;
+    }
+    printf("  %ld reads saw %ld distinct versions\n", reads, versions);
+    check(torn == 0, "no torn reads while the writer is updating");
+    check(versions > 3, "readers observe the writer's progress");
+
+    // A writer that died mid-update leaves the counter odd: the reader must give up, not spin forever
+    seq_block.seq = 1;
+    seq_block_t copy;
+    seq_read(&seq_block.seq, copy.words, seq_block.words, sizeof(copy.words));
+    check(copy.words[0] == SEQ_WRITES, "a reader gives up after SEQ_MAX_RETRIES on an odd counter");
+}
+
+static void* topn_other_thread(void* arg) {
+    (void)arg;
+    for (int i = 0; i < 1000; i++) topn_record("/from-other-thread", 100);
+    return NULL;
+}
+
+void test_topn(void) {
+    printf("\n[TEST 31] Top-N paths by requests and by bytes\n");
+
+    if (topn_init(2) != 0) {
+        check(0, "topn_init");
+        return;
+    }
+
+    // 10 hot paths with distinct counts (200, 185, ...), 600 one-off paths interleaved so the
+    // 64-counter sketch keeps evicting, and one rarely requested path that is heavy in bytes
+    char path[64];
+    int cold = 0;
+    for (int r = 0; r < 200; r++) {
+        for (int i = 0; i < 10; i++) {
+            if (r >= 200 - 15 * i) continue;
+            snprintf(path, sizeof(path), "/hot%d", i);
+            topn_record(path, 1000);
+        }
+        for (int k = 0; k < 3; k++) {
+            snprintf(path, sizeof(path), "/cold%d", cold++);
+            topn_record(path, 1000);
+        }
+        if (r % 50 == 0) topn_record("/big.iso", 50 * 1024 * 1024);
+    }
+    pthread_t other;
+    pthread_create(&other, NULL, topn_other_thread, NULL);
+    pthread_join(other, NULL);
+
+    path_rate_t hits[TOPN_PUBLISH], bytes[TOPN_PUBLISH];
+    topn_collect(hits, bytes);
+
+    check(strcmp(hits[0].path, "/from-other-thread") == 0, "paths recorded by another thread are merged");
+    int ordered = 1;
+    for (int i = 0; i < 9 && i + 1 < TOPN_PUBLISH; i++) {
+        snprintf(path, sizeof(path), "/hot%d", i);
+        ordered &= strcmp(hits[i + 1].path, path) == 0;
+    }
+    check(ordered, "hot paths survive 600 one-off paths and rank by request count");
+    int descending = 1;
+    for (int i = 1; i < TOPN_PUBLISH; i++) descending &= hits[i].rate <= hits[i - 1].rate;
+    check(descending, "rates are published in descending order");
+    check(strcmp(bytes[0].path, "/big.iso") == 0, "a few large responses lead the bytes ranking");
+
+    topn_cleanup();
+}
+
+int main(void) {
+    printf("================================================\n");
+    printf("Unit Tests (Data Structures, no server needed)\n");
+    printf("Tests 23-32: Histograms, Allocator, Cache, Seqlock, Top-N, Arena\n");
+    printf("================================================\n");
+
+    test_histogram();
+    test_slab();
+    test_sketch();
+    test_tinylfu();
+    test_gdsf();
+    test_single_flight();
+    test_l1_invalidation();
+    test_seqlock();
+    test_topn();
+    test_arena_eviction();
+
+    printf("\n================================================\n");
+    printf("UNIT TEST SUMMARY\n");
+    printf("================================================\n");
+    printf("Total Tests Run:  %d\n", tests_run);
+    printf("Tests Passed:     %d\n", tests_passed);
+    printf("Tests Failed:     %d\n", tests_failed);
+    printf("Success Rate:     %.1f%%\n",
+           tests_run > 0 ? (100.0 * tests_passed / tests_run) : 0.0);
+    printf("================================================\n");
+
+    return (tests_failed == 0) ? 0 : 1;
+}
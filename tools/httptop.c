@@ -0,0 +1,193 @@
+// httptop: vista ao vivo das estatísticas do servidor, lida diretamente da memória partilhada.
+// Mapeia SHM_NAME só para leitura e usa as mesmas leituras com seqlock do master: não faz
+// pedidos HTTP nem toca em locks, por isso não tem qualquer impacto no caminho dos pedidos.
+//
+// Uso: ./tools/httptop [-d segundos] [-n iterações]
+#define _POSIX_C_SOURCE 200809L
+#include "master.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void stop_handler(int sig) {
+    (void)sig;
+    g_stop = 1;
+}
+
+// Mapeia a zona partilhada só para leitura. O tamanho depende do número de slots: vem do fstat.
+static int attach_readonly(ipc_handles_t *h) {
+    memset(h, 0, sizeof(*h));
+    h->shm_fd = shm_open(SHM_NAME, O_RDONLY, 0);
+    if (h->shm_fd < 0) {
+        fprintf(stderr, "httptop: cannot open %s (is the server running?)\n", SHM_NAME);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(h->shm_fd, &st) != 0 || (size_t)st.st_size < sizeof(shared_data_t)) {
+        fprintf(stderr, "httptop: %s is too small\n", SHM_NAME);
+        close(h->shm_fd);
+        return -1;
+    }
+    h->shm_size = st.st_size;
+    h->shared_data = mmap(NULL, h->shm_size, PROT_READ, MAP_SHARED, h->shm_fd, 0);
+    if (h->shared_data == MAP_FAILED) {
+        perror("httptop: mmap");
+        close(h->shm_fd);
+        return -1;
+    }
+
+    // Um servidor de outra versão teria outro layout
+    shared_data_t *shm = h->shared_data;
+    if (shm->num_workers <= 0 || shm->num_workers > MAX_WORKERS || shm->threads_per_worker <= 0 ||
+        SHARED_DATA_SIZE(shm->num_workers * shm->threads_per_worker) != h->shm_size) {
+        fprintf(stderr, "httptop: shared memory layout does not match this build\n");
+        munmap(h->shared_data, h->shm_size);
+        close(h->shm_fd);
+        return -1;
+    }
+    return 0;
+}
+
+static void print_latency(const char *label, const hist_t *h) {
+    printf("  %-12s %8lu %8lu %8lu %8lu %8lu %10lu\n", label, hist_percentile(h, 50), hist_percentile(h, 90),
+           hist_percentile(h, 99), hist_percentile(h, 99.9), h->max_us, h->count);
+}
+
+// Estado da iteração anterior, para os ritmos
+typedef struct {
+    int valid;
+    struct timespec when;
+    server_stats_t stats;
+    uint64_t worker_requests[MAX_WORKERS];
+} sample_t;
+
+static void render(ipc_handles_t *h, sample_t *prev, double delay, int clear) {
+    shared_data_t *shm = h->shared_data;
+    int workers = shm->num_workers;
+
+    sample_t *cur = calloc(1, sizeof(sample_t));
+    if (!cur) return;
+    clock_gettime(CLOCK_MONOTONIC, &cur->when);
+    stats_snapshot(h, &cur->stats);
+    for (int w = 0; w < workers; w++) cur->worker_requests[w] = stats_worker_requests(h, w);
+    server_stats_t *s = &cur->stats;
+
+    double dt = prev->valid ? timespec_diff_us(&prev->when, &cur->when) / 1e6 : 0;
+    double rps = 0, bps = 0, err4 = 0, err5 = 0;
+    hist_t interval;
+    memset(&interval, 0, sizeof(interval));
+    if (dt > 0) {
+        rps = (s->total_requests - prev->stats.total_requests) / dt;
+        bps = (s->bytes_transferred - prev->stats.bytes_transferred) / dt;
+        err4 = (s->status_class[4] - prev->stats.status_class[4]) / dt;
+        err5 = (s->status_class[5] - prev->stats.status_class[5]) / dt;
+        hist_diff(&interval, &s->latency, &prev->stats.latency);
+    }
+
+    if (clear) printf("\033[H\033[2J");
+    long up = (long)(time(NULL) - s->start_time);
+    printf("httptop - up %02ld:%02ld:%02ld, %d workers x %d threads, refresh %.1fs\n",
+           up / 3600, (up / 60) % 60, up % 60, workers, shm->threads_per_worker, delay);
+    printf("Requests: %lu total, %.1f req/s, %.2f MB/s   Active: %u   Accept queue: %u / %u\n",
+           s->total_requests, rps, bps / (1024 * 1024), s->active_connections,
+           __atomic_load_n(&shm->accept_queue, __ATOMIC_RELAXED), __atomic_load_n(&shm->accept_backlog, __ATOMIC_RELAXED));
+    printf("Errors: 4xx %.1f/s, 5xx %.1f/s (lifetime %lu / %lu)\n", err4, err5, s->status_class[4], s->status_class[5]);
+
+    // Janelas fixas do anel do master, independentes do intervalo de refrescamento
+    static const int windows[RATE_WINDOW_COUNT] = RATE_WINDOWS;
+    printf("Rolling:");
+    for (int r = 0; r < RATE_WINDOW_COUNT; r++) {
+        rate_stats_t rt;
+        stats_rates(h, windows[r], &rt);
+        printf("%s %ds %.1f req/s %.2f MB/s %.1f err/s", r ? "," : "", windows[r], rt.requests,
+               rt.bytes / (1024 * 1024), rt.status_class[4] + rt.status_class[5]);
+    }
+    printf("\n\n");
+
+    printf("  %-12s %8s %8s %8s %8s %8s %10s\n", "LATENCY (us)", "p50", "p90", "p99", "p99.9", "max", "requests");
+    char label[32];
+    snprintf(label, sizeof(label), "last %.0fs", delay);
+    if (dt > 0) print_latency(label, &interval);
+    print_latency("last " STATS_WINDOW_LABEL, &s->latency_window);
+    print_latency("lifetime", &s->latency);
+
+    cache_stats_t c;
+    stats_cache_totals(h, &c);
+    uint64_t lookups = c.hits + c.misses;
+    printf("\nCache: %.1f%% hits (%.1f%% in L1), %lu entries, %.2f / %.2f MB, %lu evicted, %lu rejected\n\n",
+           lookups ? 100.0 * c.hits / lookups : 0.0, lookups ? 100.0 * c.l1_hits / lookups : 0.0, c.entries,
+           (double)c.bytes_used / (1024 * 1024), (double)c.bytes_budget / (1024 * 1024),
+           c.evictions_capacity + c.evictions_stale + c.evictions_resize, c.admission_rejects + c.size_rejects);
+
+    printf("%6s %9s %7s %9s %8s %15s %9s %8s\n", "WORKER", "REQ/S", "ACTIVE", "CACHE HIT", "ENTRIES", "CACHE MB", "RSS MB", "SW/REQ");
+    for (int w = 0; w < workers; w++) {
+        cache_stats_t wc;
+        proc_stats_t p;
+        stats_worker_cache(h, w, &wc);
+        stats_worker_proc(h, w, &p);
+        uint64_t wl = wc.hits + wc.misses;
+        double wrps = dt > 0 ? (cur->worker_requests[w] - prev->worker_requests[w]) / dt : 0;
+        char mb[32];
+        snprintf(mb, sizeof(mb), "%.1f / %.1f", (double)wc.bytes_used / (1024 * 1024), (double)wc.bytes_budget / (1024 * 1024));
+        printf("%6d %9.1f %7u %8.1f%% %8lu %15s %9.1f %8.2f\n", w, wrps, stats_worker_active(h, w),
+               wl ? 100.0 * wc.hits / wl : 0.0, wc.entries, mb, (double)p.rss_bytes / (1024 * 1024), p.switches_per_request);
+    }
+
+    path_rate_t top[TOPN_PUBLISH];
+    stats_top_paths(h, 0, top);
+    if (top[0].path[0]) {
+        printf("\n%-60s %9s\n", "TOP PATHS", "REQ/S");
+        for (int k = 0; k < TOPN_PUBLISH && top[k].path[0]; k++) printf("%-60.60s %9.1f\n", top[k].path, top[k].rate);
+    }
+    fflush(stdout);
+
+    *prev = *cur;
+    prev->valid = 1;
+    free(cur);
+}
+
+int main(int argc, char *argv[]) {
+    double delay = 1.0;
+    long iterations = -1;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:n:h")) != -1) {
+        if (opt == 'd') delay = atof(optarg);
+        else if (opt == 'n') iterations = atol(optarg);
+        else {
+            fprintf(stderr, "Usage: %s [-d seconds] [-n iterations]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (delay < 0.1) delay = 0.1;
+
+    ipc_handles_t h;
+    if (attach_readonly(&h) != 0) return 1;
+
+    struct sigaction sa = { .sa_handler = stop_handler };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    // Fora de um terminal (ex: redirecionado para um ficheiro) não limpa o ecrã
+    int clear = isatty(STDOUT_FILENO);
+    sample_t *prev = calloc(1, sizeof(sample_t));
+    if (!prev) return 1;
+    while (!g_stop && iterations != 0) {
+        render(&h, prev, delay, clear);
+        if (iterations > 0 && --iterations == 0) break;
+        if (!clear) printf("\n");
+        struct timespec ts = { (time_t)delay, (long)((delay - (time_t)delay) * 1e9) };
+        nanosleep(&ts, NULL);
+    }
+
+    free(prev);
+    munmap(h.shared_data, h.shm_size);
+    close(h.shm_fd);
+    return 0;
+}